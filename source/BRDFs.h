@@ -56,17 +56,16 @@ namespace dae
 		 * \brief BRDF NormalDistribution >> Trowbridge-Reitz GGX (UE4 implemetation - squared(roughness))
 		 * \param n Surface normal
 		 * \param h Normalized half vector
-		 * \param roughness Roughness of the material
+		 * \param alphaSquared Square(alpha) with alpha = Square(roughness), precomputed per material
 		 * \return BRDF Normal Distribution Term using Trowbridge-Reitz GGX
 		 */
-		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float roughness)
+		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float alphaSquared)
 		{
-			float alpha = Square(roughness);
-			float denom = Square(Vector3::Dot(n, h)) * (alpha * alpha - 1) + 1;
+			float denom = Square(Vector3::Dot(n, h)) * (alphaSquared - 1) + 1;
 			denom *= denom;
 			denom *= PI;
 
-			return (float) Square(alpha) / denom;
+			return alphaSquared / denom;
 		}
 
 
@@ -74,13 +73,11 @@ namespace dae
 		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
-		 * \param roughness Roughness of the material
+		 * \param k Square(alpha + 1) / 8 with alpha = Square(roughness), precomputed per material
 		 * \return BRDF Geometry Term using SchlickGGX
 		 */
-		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float roughness)
+		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float k)
 		{
-			float alpha = Square(roughness);
-			float k = (float) Square(alpha + 1) / 8.f;
 			float nom = Vector3::Dot(n, v);
 			float denom = nom * (1 - k);
 			denom += k;
@@ -98,13 +95,13 @@ namespace dae
 		 * \param n Normal of the surface
 		 * \param v Normalized view direction
 		 * \param l Normalized light direction
-		 * \param roughness Roughness of the material
-		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,roughness) * SchlickGGX(n,l,roughness))
+		 * \param k Schlick-GGX k of the material
+		 * \return BRDF Geometry Term using Smith (> SchlickGGX(n,v,k) * SchlickGGX(n,l,k))
 		 */
-		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
+		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float k)
 		{
-			float result = GeometryFunction_SchlickGGX(n, v, roughness) *
-				GeometryFunction_SchlickGGX(n, l, roughness);
+			float result = GeometryFunction_SchlickGGX(n, v, k) *
+				GeometryFunction_SchlickGGX(n, l, k);
 
 			result = result > 0 ? result : 0;
 			return result;
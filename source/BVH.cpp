@@ -0,0 +1,562 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace dae {
+namespace
+{
+	struct BVHBin
+	{
+		Vector3 minAABB{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maxAABB{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t primitiveCount{};
+
+		void Grow(const Vector3& minPoint, const Vector3& maxPoint)
+		{
+			minAABB = Vector3::Min(minAABB, minPoint);
+			maxAABB = Vector3::Max(maxAABB, maxPoint);
+		}
+
+		void Grow(const BVHBin& bin)
+		{
+			if (bin.primitiveCount == 0)
+				return;
+
+			Grow(bin.minAABB, bin.maxAABB);
+		}
+	};
+
+	// Start of a serialized tree. Nodes are stored as they are in memory, the node size tells builds with a padded Vector3 apart.
+	struct BVHBlockHeader
+	{
+		char magic[4];
+		uint32_t nodeSize;
+		uint32_t leafWidth;
+		uint32_t nodeCount;
+		uint32_t primitiveCount;
+		float buildCost;
+		// From the start of the block
+		uint64_t nodesOffset;
+		uint64_t primitiveIndicesOffset;
+	};
+
+	constexpr char BVHBlockMagic[4]{ 'B', 'V', 'H', '1' };
+
+	size_t AlignOffset(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	// Spreads the lower 10 bits of value out to every third bit
+	uint32_t ExpandBits(uint32_t value)
+	{
+		value = (value * 0x00010001u) & 0xFF0000FFu;
+		value = (value * 0x00000101u) & 0x0F00F00Fu;
+		value = (value * 0x00000011u) & 0xC30C30C3u;
+		value = (value * 0x00000005u) & 0x49249249u;
+		return value;
+	}
+
+	// Interleaves 10 bits per axis of a point in [0, 1]
+	uint32_t CalculateMortonCode(float x, float y, float z)
+	{
+		const auto quantize = [](float value) { return static_cast<uint32_t>(std::clamp(value * 1024.f, 0.f, 1023.f)); };
+		return (ExpandBits(quantize(x)) << 2) | (ExpandBits(quantize(y)) << 1) | ExpandBits(quantize(z));
+	}
+
+	// Every child and every leaf range stays inside the arrays, and children always come after their parent, so traversal ends.
+	// No node lies deeper than the builder goes, the traversal stacks hold BVH::MaxDepth entries.
+	// Primitive indices only have to stay below the primitive count, a block with repeated ones still traverses safely.
+	bool IsValidTree(const BVHNode* pNodes, uint32_t nodeCount, const uint32_t* pPrimitiveIndices, uint32_t primitiveCount)
+	{
+		// Parents come first, so a node has its deepest path from the root by the time it is visited
+		std::vector<uint8_t> depths(nodeCount);
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			const BVHNode& node = pNodes[i];
+			if (node.IsLeaf()) {
+				if (uint64_t(node.leftFirst) + node.primitiveCount > primitiveCount)
+					return false;
+				continue;
+			}
+
+			if (node.leftFirst <= i || uint64_t(node.leftFirst) + 1 >= nodeCount || depths[i] >= BVH::MaxDepth)
+				return false;
+			const uint8_t childDepth = static_cast<uint8_t>(depths[i] + 1);
+			depths[node.leftFirst] = std::max(depths[node.leftFirst], childDepth);
+			depths[node.leftFirst + 1] = std::max(depths[node.leftFirst + 1], childDepth);
+		}
+		return std::all_of(pPrimitiveIndices, pPrimitiveIndices + primitiveCount, [primitiveCount](uint32_t index) { return index < primitiveCount; });
+	}
+}
+
+	void BVH::Build(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+	{
+		CalculateTriangleBounds(positions, indices);
+		BuildFromBounds();
+	}
+
+	void BVH::Build(const std::vector<Vector3>& primitiveMins, const std::vector<Vector3>& primitiveMaxs)
+	{
+		m_PrimitiveMins = primitiveMins;
+		m_PrimitiveMaxs = primitiveMaxs;
+
+		BuildFromBounds();
+	}
+
+	void BVH::Assign(std::vector<BVHNode> builtNodes, std::vector<uint32_t> builtPrimitiveIndices)
+	{
+		m_pMapping.reset();
+		nodes = std::move(builtNodes);
+		primitiveIndices = std::move(builtPrimitiveIndices);
+		nodesUsed = static_cast<uint32_t>(nodes.size());
+
+		// Refits measure against the tree as it was built, which is this one
+		m_BuildCost = CalculateCost();
+	}
+
+	size_t BVH::Serialize(std::vector<char>& buffer) const
+	{
+		const uint32_t primitiveCount = GetPrimitiveCount();
+
+		BVHBlockHeader header{};
+		std::memcpy(header.magic, BVHBlockMagic, sizeof(header.magic));
+		header.nodeSize = sizeof(BVHNode);
+		header.leafWidth = m_LeafWidth;
+		header.nodeCount = nodesUsed;
+		header.primitiveCount = primitiveCount;
+		header.buildCost = m_BuildCost;
+		header.nodesOffset = AlignOffset(sizeof(BVHBlockHeader), BlockAlignment);
+		header.primitiveIndicesOffset = header.nodesOffset + size_t(nodesUsed) * sizeof(BVHNode);
+
+		const size_t blockOffset = AlignOffset(buffer.size(), BlockAlignment);
+		buffer.resize(blockOffset + header.primitiveIndicesOffset + size_t(primitiveCount) * sizeof(uint32_t));
+
+		char* pBlock = buffer.data() + blockOffset;
+		std::memcpy(pBlock, &header, sizeof(header));
+		if (nodesUsed > 0)
+			std::memcpy(pBlock + header.nodesOffset, GetNodes(), size_t(nodesUsed) * sizeof(BVHNode));
+		if (primitiveCount > 0)
+			std::memcpy(pBlock + header.primitiveIndicesOffset, GetPrimitiveIndices(), size_t(primitiveCount) * sizeof(uint32_t));
+		return blockOffset;
+	}
+
+	bool BVH::Attach(std::shared_ptr<const MappedFile> pMapping, size_t offset, uint32_t nrPrimitives)
+	{
+		const size_t size = pMapping->GetSize();
+		if (offset % BlockAlignment != 0 || offset > size || size - offset < sizeof(BVHBlockHeader))
+			return false;
+
+		const char* pBlock = pMapping->GetData() + offset;
+		BVHBlockHeader header{};
+		std::memcpy(&header, pBlock, sizeof(header));
+		if (std::memcmp(header.magic, BVHBlockMagic, sizeof(header.magic)) != 0 || header.nodeSize != sizeof(BVHNode) || header.leafWidth != m_LeafWidth
+			|| header.primitiveCount != nrPrimitives)
+			return false;
+
+		// The nodes offset is checked against the mapping first, so none of the sums below can overflow
+		const uint64_t maxBlockSize = size - offset;
+		if (header.nodesOffset < sizeof(BVHBlockHeader) || header.nodesOffset % BlockAlignment != 0 || header.nodesOffset > maxBlockSize
+			|| header.primitiveIndicesOffset != header.nodesOffset + uint64_t(header.nodeCount) * sizeof(BVHNode)
+			|| header.primitiveIndicesOffset + uint64_t(header.primitiveCount) * sizeof(uint32_t) > maxBlockSize)
+			return false;
+
+		const BVHNode* pMappedNodes = reinterpret_cast<const BVHNode*>(pBlock + header.nodesOffset);
+		const uint32_t* pMappedPrimitiveIndices = reinterpret_cast<const uint32_t*>(pBlock + header.primitiveIndicesOffset);
+		if (!IsValidTree(pMappedNodes, header.nodeCount, pMappedPrimitiveIndices, header.primitiveCount))
+			return false;
+
+		nodes.clear();
+		primitiveIndices.clear();
+		nodesUsed = header.nodeCount;
+		m_BuildCost = header.buildCost;
+
+		m_pMappedNodes = pMappedNodes;
+		m_pMappedPrimitiveIndices = pMappedPrimitiveIndices;
+		m_MappedPrimitiveCount = header.primitiveCount;
+		m_pMapping = std::move(pMapping);
+		return true;
+	}
+
+	void BVH::Detach()
+	{
+		if (!m_pMapping)
+			return;
+
+		nodes.assign(m_pMappedNodes, m_pMappedNodes + nodesUsed);
+		primitiveIndices.assign(m_pMappedPrimitiveIndices, m_pMappedPrimitiveIndices + m_MappedPrimitiveCount);
+		m_pMapping.reset();
+	}
+
+	void BVH::Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+	{
+		CalculateTriangleBounds(positions, indices);
+		RefitFromBounds();
+	}
+
+	void BVH::Refit(const std::vector<Vector3>& primitiveMins, const std::vector<Vector3>& primitiveMaxs)
+	{
+		m_PrimitiveMins = primitiveMins;
+		m_PrimitiveMaxs = primitiveMaxs;
+
+		RefitFromBounds();
+	}
+
+	float BVH::CalculateCost() const
+	{
+		if (nodesUsed == 0)
+			return 0.f;
+
+		// Traversing an inner node and intersecting a group of leafWidth primitives are both counted as cost 1.
+		const BVHNode* pNodes = GetNodes();
+		float cost = 0.f;
+		for (uint32_t i = 0; i < nodesUsed; i++) {
+			const BVHNode& node = pNodes[i];
+			const float area = BVHUtils::GetSurfaceArea(node.minAABB, node.maxAABB);
+			cost += node.IsLeaf() ? area * GetLeafGroups(node.primitiveCount) : area;
+		}
+
+		const float rootArea = BVHUtils::GetSurfaceArea(pNodes[0].minAABB, pNodes[0].maxAABB);
+		return rootArea > 0.f ? cost / rootArea : 0.f;
+	}
+
+	void BVH::CalculateTriangleBounds(const std::vector<Vector3>& positions, const std::vector<int>& indices)
+	{
+		const size_t nrTriangles = indices.size() / 3;
+
+		m_PrimitiveMins.resize(nrTriangles);
+		m_PrimitiveMaxs.resize(nrTriangles);
+		for (size_t i = 0; i < nrTriangles; i++) {
+			const Vector3& v0 = positions[indices[i * 3]];
+			const Vector3& v1 = positions[indices[i * 3 + 1]];
+			const Vector3& v2 = positions[indices[i * 3 + 2]];
+
+			m_PrimitiveMins[i] = Vector3::Min(v0, Vector3::Min(v1, v2));
+			m_PrimitiveMaxs[i] = Vector3::Max(v0, Vector3::Max(v1, v2));
+		}
+	}
+
+	void BVH::BuildFromBounds()
+	{
+		const uint32_t nrPrimitives = static_cast<uint32_t>(m_PrimitiveMins.size());
+
+		m_pMapping.reset();
+		nodes.clear();
+		nodesUsed = 0;
+		if (nrPrimitives == 0)
+			return;
+
+		// Precompute the centroids, these decide which side of a split a primitive ends up on.
+		m_Centroids.resize(nrPrimitives);
+		primitiveIndices.resize(nrPrimitives);
+		for (uint32_t i = 0; i < nrPrimitives; i++) {
+			m_Centroids[i] = (m_PrimitiveMins[i] + m_PrimitiveMaxs[i]) * 0.5f;
+			primitiveIndices[i] = i;
+		}
+
+		// A binary tree over n leaves never needs more than 2n - 1 nodes.
+		nodes.resize(2 * nrPrimitives - 1);
+
+		BVHNode& root = nodes[0];
+		root.leftFirst = 0;
+		root.primitiveCount = nrPrimitives;
+		nodesUsed = 1;
+
+		UpdateNodeBounds(root);
+		if (m_BuildMode == BuildMode::Morton)
+			SortByMortonCode();
+
+		if (m_pThreadPool && m_pThreadPool->GetNrThreads() > 1 && nrPrimitives >= MinParallelBuildSize)
+			SubdivideParallel();
+		else
+			Subdivide(nodes, nodesUsed, 0, 1);
+
+		m_BuildCost = CalculateCost();
+	}
+
+	void BVH::SortByMortonCode()
+	{
+		const uint32_t nrPrimitives = static_cast<uint32_t>(m_Centroids.size());
+
+		// The codes span the bounds of the centroids, the primitive bounds would leave part of the grid unused
+		Vector3 centroidMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 centroidMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (const Vector3& centroid : m_Centroids) {
+			centroidMin = Vector3::Min(centroidMin, centroid);
+			centroidMax = Vector3::Max(centroidMax, centroid);
+		}
+		const Vector3 extent = centroidMax - centroidMin;
+		const Vector3 scale{
+			extent.x > 0.f ? 1.f / extent.x : 0.f,
+			extent.y > 0.f ? 1.f / extent.y : 0.f,
+			extent.z > 0.f ? 1.f / extent.z : 0.f
+		};
+
+		// Code in the high half, primitive in the low half: sorting the keys sorts the primitives, equal codes stay in primitive order
+		std::vector<uint64_t> keys(nrPrimitives);
+		for (uint32_t i = 0; i < nrPrimitives; i++) {
+			const Vector3 offset = m_Centroids[i] - centroidMin;
+			keys[i] = uint64_t(CalculateMortonCode(offset.x * scale.x, offset.y * scale.y, offset.z * scale.z)) << 32 | i;
+		}
+		std::sort(keys.begin(), keys.end());
+
+		m_MortonCodes.resize(nrPrimitives);
+		for (uint32_t i = 0; i < nrPrimitives; i++) {
+			primitiveIndices[i] = static_cast<uint32_t>(keys[i]);
+			m_MortonCodes[i] = static_cast<uint32_t>(keys[i] >> 32);
+		}
+	}
+
+	void BVH::RefitFromBounds()
+	{
+		if (nodesUsed == 0 || GetPrimitiveCount() != m_PrimitiveMins.size()) {
+			BuildFromBounds();
+			return;
+		}
+		Detach();
+
+		// Children are always allocated after their parent, so walking backwards visits them first.
+		for (int i = static_cast<int>(nodesUsed) - 1; i >= 0; i--) {
+			BVHNode& node = nodes[i];
+			if (node.IsLeaf()) {
+				UpdateNodeBounds(node);
+				continue;
+			}
+
+			const BVHNode& leftChild = nodes[node.leftFirst];
+			const BVHNode& rightChild = nodes[node.leftFirst + 1];
+			node.minAABB = Vector3::Min(leftChild.minAABB, rightChild.minAABB);
+			node.maxAABB = Vector3::Max(leftChild.maxAABB, rightChild.maxAABB);
+		}
+
+		if (CalculateCost() > m_BuildCost * MaxRefitCostRatio)
+			BuildFromBounds();
+	}
+
+	void BVH::UpdateNodeBounds(BVHNode& node) const
+	{
+		node.minAABB = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		node.maxAABB = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		for (uint32_t i = 0; i < node.primitiveCount; i++) {
+			const uint32_t primitiveIndex = primitiveIndices[node.leftFirst + i];
+			node.minAABB = Vector3::Min(node.minAABB, m_PrimitiveMins[primitiveIndex]);
+			node.maxAABB = Vector3::Max(node.maxAABB, m_PrimitiveMaxs[primitiveIndex]);
+		}
+	}
+
+	void BVH::Subdivide(std::vector<BVHNode>& targetNodes, uint32_t& targetNodesUsed, uint32_t nodeIndex, int depth)
+	{
+		if (!SplitNode(targetNodes, targetNodesUsed, nodeIndex, depth))
+			return;
+
+		const uint32_t leftChildIndex = targetNodes[nodeIndex].leftFirst;
+		Subdivide(targetNodes, targetNodesUsed, leftChildIndex, depth + 1);
+		Subdivide(targetNodes, targetNodesUsed, leftChildIndex + 1, depth + 1);
+	}
+
+	// Splits the top of the tree on the calling thread until there are enough subtrees to keep every thread busy, then builds those in parallel.
+	// Every node splits the same way as in a single threaded build, only the order of the nodes in the array differs.
+	void BVH::SubdivideParallel()
+	{
+		constexpr size_t SubtreesPerThread = 4;
+
+		struct Subtree
+		{
+			uint32_t nodeIndex;
+			int depth;
+		};
+
+		// The largest subtree is split first, leaves drop out of the list
+		std::vector<Subtree> subtrees{ { 0, 1 } };
+		const size_t targetNrSubtrees = m_pThreadPool->GetNrThreads() * SubtreesPerThread;
+		while (!subtrees.empty() && subtrees.size() < targetNrSubtrees) {
+			const auto largest = std::max_element(subtrees.begin(), subtrees.end(), [this](const Subtree& subtree1, const Subtree& subtree2) {
+				return nodes[subtree1.nodeIndex].primitiveCount < nodes[subtree2.nodeIndex].primitiveCount;
+				});
+			if (nodes[largest->nodeIndex].primitiveCount < MinParallelBuildSize)
+				break;
+
+			const Subtree subtree = *largest;
+			subtrees.erase(largest);
+			if (!SplitNode(nodes, nodesUsed, subtree.nodeIndex, subtree.depth))
+				continue;
+
+			const uint32_t leftChildIndex = nodes[subtree.nodeIndex].leftFirst;
+			subtrees.push_back({ leftChildIndex, subtree.depth + 1 });
+			subtrees.push_back({ leftChildIndex + 1, subtree.depth + 1 });
+		}
+
+		// Every subtree is built into an array of its own with its root at 0, the subtrees only share
+		// the read-only primitive bounds and their own disjoint ranges of primitiveIndices
+		const uint32_t nrSubtrees = static_cast<uint32_t>(subtrees.size());
+		std::vector<std::vector<BVHNode>> subtreeNodes(nrSubtrees);
+		std::vector<uint32_t> subtreeNodesUsed(nrSubtrees);
+		m_pThreadPool->ParallelFor(nrSubtrees, [&](uint32_t subtreeIndex) {
+			const BVHNode& root = nodes[subtrees[subtreeIndex].nodeIndex];
+			std::vector<BVHNode>& localNodes = subtreeNodes[subtreeIndex];
+			localNodes.resize(2 * size_t(root.primitiveCount) - 1);
+			localNodes[0] = root;
+
+			uint32_t localNodesUsed = 1;
+			Subdivide(localNodes, localNodesUsed, 0, subtrees[subtreeIndex].depth);
+			subtreeNodesUsed[subtreeIndex] = localNodesUsed;
+			});
+
+		// The roots go back in place, the other nodes are appended behind the top of the tree so children still follow their parents
+		for (uint32_t subtreeIndex = 0; subtreeIndex < nrSubtrees; subtreeIndex++) {
+			const std::vector<BVHNode>& localNodes = subtreeNodes[subtreeIndex];
+			const uint32_t offset = nodesUsed - 1;
+			const auto relocate = [offset](BVHNode node) {
+				if (!node.IsLeaf())
+					node.leftFirst += offset;
+				return node;
+			};
+
+			nodes[subtrees[subtreeIndex].nodeIndex] = relocate(localNodes[0]);
+			for (uint32_t localIndex = 1; localIndex < subtreeNodesUsed[subtreeIndex]; localIndex++)
+				nodes[nodesUsed++] = relocate(localNodes[localIndex]);
+		}
+	}
+
+	bool BVH::SplitNode(std::vector<BVHNode>& targetNodes, uint32_t& targetNodesUsed, uint32_t nodeIndex, int depth)
+	{
+		BVHNode& node = targetNodes[nodeIndex];
+		if (node.primitiveCount <= 2 || node.primitiveCount <= m_LeafWidth || depth >= MaxDepth)
+			return false;
+
+		const uint32_t leftCount = m_BuildMode == BuildMode::Morton ? FindMortonSplit(node) : PartitionSAH(node);
+		if (leftCount == 0 || leftCount == node.primitiveCount)
+			return false;
+
+		const uint32_t leftChildIndex = targetNodesUsed++;
+		const uint32_t rightChildIndex = targetNodesUsed++;
+
+		BVHNode& leftChild = targetNodes[leftChildIndex];
+		BVHNode& rightChild = targetNodes[rightChildIndex];
+		leftChild.leftFirst = node.leftFirst;
+		leftChild.primitiveCount = leftCount;
+		rightChild.leftFirst = node.leftFirst + leftCount;
+		rightChild.primitiveCount = node.primitiveCount - leftCount;
+
+		node.leftFirst = leftChildIndex;
+		node.primitiveCount = 0;
+
+		UpdateNodeBounds(leftChild);
+		UpdateNodeBounds(rightChild);
+		return true;
+	}
+
+	uint32_t BVH::PartitionSAH(const BVHNode& node)
+	{
+		// Only split if the SAH says it is cheaper than intersecting every primitive in this node.
+		int axis{};
+		float splitPosition{};
+		const float splitCost = FindBestSplit(node, axis, splitPosition);
+		const float leafCost = GetLeafGroups(node.primitiveCount) * BVHUtils::GetSurfaceArea(node.minAABB, node.maxAABB);
+		if (splitCost >= leafCost)
+			return 0;
+
+		// Partition the primitives in place, everything left of the split plane moves to the front.
+		int i = static_cast<int>(node.leftFirst);
+		int j = i + static_cast<int>(node.primitiveCount) - 1;
+		while (i <= j) {
+			if (m_Centroids[primitiveIndices[i]][axis] < splitPosition)
+				i++;
+			else
+				std::swap(primitiveIndices[i], primitiveIndices[j--]);
+		}
+
+		return static_cast<uint32_t>(i) - node.leftFirst;
+	}
+
+	// The primitives of a node are sorted on their codes, the split goes where the highest bit in which the codes of the node differ flips.
+	uint32_t BVH::FindMortonSplit(const BVHNode& node) const
+	{
+		const uint32_t first = node.leftFirst;
+		const uint32_t last = first + node.primitiveCount - 1;
+		const uint32_t differentBits = m_MortonCodes[first] ^ m_MortonCodes[last];
+
+		// Primitives in the same grid cell have nothing left to split on, halve them
+		if (differentBits == 0)
+			return node.primitiveCount / 2;
+
+		// Binary search for the first code with the bit set, the code at low never has it and the one at high always does
+		const uint32_t bit = 31 - std::countl_zero(differentBits);
+		uint32_t low = first;
+		uint32_t high = last;
+		while (high - low > 1) {
+			const uint32_t middle = low + (high - low) / 2;
+			if (m_MortonCodes[middle] >> bit & 1)
+				high = middle;
+			else
+				low = middle;
+		}
+		return high - first;
+	}
+
+	// Bins the centroids along every axis and evaluates the SAH at each bin boundary. Returns the cost of the best split.
+	float BVH::FindBestSplit(const BVHNode& node, int& axis, float& splitPosition) const
+	{
+		float bestCost = FLT_MAX;
+
+		for (int a = 0; a < 3; a++) {
+			float boundsMin = FLT_MAX;
+			float boundsMax = -FLT_MAX;
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				const float centroid = m_Centroids[primitiveIndices[node.leftFirst + i]][a];
+				boundsMin = std::min(boundsMin, centroid);
+				boundsMax = std::max(boundsMax, centroid);
+			}
+
+			if (boundsMin == boundsMax)
+				continue;
+
+			// Fill the bins with the primitive bounds.
+			BVHBin bins[NrBins]{};
+			const float scale = NrBins / (boundsMax - boundsMin);
+			for (uint32_t i = 0; i < node.primitiveCount; i++) {
+				const uint32_t primitiveIndex = primitiveIndices[node.leftFirst + i];
+				const int binIndex = std::min(NrBins - 1, static_cast<int>((m_Centroids[primitiveIndex][a] - boundsMin) * scale));
+
+				BVHBin& bin = bins[binIndex];
+				bin.primitiveCount++;
+				bin.Grow(m_PrimitiveMins[primitiveIndex], m_PrimitiveMaxs[primitiveIndex]);
+			}
+
+			// Sweep from both sides to get the area and count left and right of every boundary.
+			float leftArea[NrBins - 1]{}, rightArea[NrBins - 1]{};
+			uint32_t leftCount[NrBins - 1]{}, rightCount[NrBins - 1]{};
+			BVHBin leftBox{}, rightBox{};
+			uint32_t leftSum = 0, rightSum = 0;
+
+			for (int i = 0; i < NrBins - 1; i++) {
+				leftSum += bins[i].primitiveCount;
+				leftCount[i] = leftSum;
+				leftBox.Grow(bins[i]);
+				leftArea[i] = leftSum > 0 ? BVHUtils::GetSurfaceArea(leftBox.minAABB, leftBox.maxAABB) : 0.f;
+
+				rightSum += bins[NrBins - 1 - i].primitiveCount;
+				rightCount[NrBins - 2 - i] = rightSum;
+				rightBox.Grow(bins[NrBins - 1 - i]);
+				rightArea[NrBins - 2 - i] = rightSum > 0 ? BVHUtils::GetSurfaceArea(rightBox.minAABB, rightBox.maxAABB) : 0.f;
+			}
+
+			const float binWidth = (boundsMax - boundsMin) / NrBins;
+			for (int i = 0; i < NrBins - 1; i++) {
+				const float cost = GetLeafGroups(leftCount[i]) * leftArea[i] + GetLeafGroups(rightCount[i]) * rightArea[i];
+				if (cost < bestCost) {
+					bestCost = cost;
+					axis = a;
+					splitPosition = boundsMin + binWidth * (i + 1);
+				}
+			}
+		}
+
+		return bestCost;
+	}
+}
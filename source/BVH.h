@@ -0,0 +1,145 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	class MappedFile;
+	class ThreadPool;
+
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+
+		// Inner node: index of the left child (the right child directly follows it).
+		// Leaf node: index of the first primitive in BVH::primitiveIndices.
+		uint32_t leftFirst{};
+		uint32_t primitiveCount{};
+
+		bool IsLeaf() const { return primitiveCount > 0; }
+	};
+
+	// Bounding volume hierarchy built with the surface area heuristic, or from Morton codes.
+	// Used per mesh over its triangles (bottom level) and per scene over all bounded primitives (top level).
+	struct BVH
+	{
+		// Traversal uses a fixed size stack, so the builder never goes deeper than this.
+		static constexpr int MaxDepth = 64;
+		static constexpr int NrBins = 16;
+		// A refitted tree whose SAH cost grew beyond this factor of the cost right after building gets rebuilt.
+		static constexpr float MaxRefitCostRatio = 1.5f;
+		// Subtrees with fewer primitives are built on a single thread, trees with fewer are built entirely on the calling thread.
+		static constexpr uint32_t MinParallelBuildSize = 4096;
+
+		enum class BuildMode : uint8_t
+		{
+			// Binned SAH splits: the better tree, the slower build
+			SAH,
+			// Linear BVH: primitives sorted along a Morton curve and split at the highest differing bit of their codes.
+			// Builds several times faster for a somewhat worse tree, for geometry that rebuilds often.
+			Morton
+		};
+
+		// leafWidth is the number of primitives the leaf intersector tests at once. The SAH counts a leaf per group
+		// of leafWidth primitives, so wide kernels get leaves that fill their lanes.
+		explicit BVH(uint32_t leafWidth = 1) : m_LeafWidth{ leafWidth } {}
+
+		// Storage of a tree built or assigned in memory, both stay empty while the tree is attached to a mapped file.
+		std::vector<BVHNode> nodes{};
+		std::vector<uint32_t> primitiveIndices{};
+		uint32_t nodesUsed{};
+
+		// Traversal reads the tree through these, so it does not care where the tree lives
+		const BVHNode* GetNodes() const { return m_pMapping ? m_pMappedNodes : nodes.data(); }
+		const uint32_t* GetPrimitiveIndices() const { return m_pMapping ? m_pMappedPrimitiveIndices : primitiveIndices.data(); }
+		uint32_t GetPrimitiveCount() const { return m_pMapping ? m_MappedPrimitiveCount : static_cast<uint32_t>(primitiveIndices.size()); }
+		bool IsEmpty() const { return nodesUsed == 0; }
+		bool IsMapped() const { return m_pMapping != nullptr; }
+
+		void SetBuildMode(BuildMode buildMode) { m_BuildMode = buildMode; }
+		BuildMode GetBuildMode() const { return m_BuildMode; }
+		// Large trees are built over subtrees in parallel on the pool, e.g. the renderer's. Without a pool everything runs on the calling thread.
+		void SetThreadPool(ThreadPool* pThreadPool) { m_pThreadPool = pThreadPool; }
+
+		// Build over the triangles of an indexed mesh.
+		void Build(const std::vector<Vector3>& positions, const std::vector<int>& indices);
+		// Build over arbitrary primitives, given their bounding boxes.
+		void Build(const std::vector<Vector3>& primitiveMins, const std::vector<Vector3>& primitiveMaxs);
+		// Take over a tree that was built earlier. Every node is in use.
+		void Assign(std::vector<BVHNode> builtNodes, std::vector<uint32_t> builtPrimitiveIndices);
+
+#pragma region Serialization
+		// Serialized trees start at a multiple of this in their file, the node array is aligned to it within the block.
+		static constexpr size_t BlockAlignment = 64;
+
+		// Appends the tree to buffer as one flat block: a header, the node array and the primitive indices, each at an offset from the block start.
+		// Nodes refer to their children by index, so the block can be used in place wherever it is mapped, without fixups.
+		// The buffer is padded first so the block starts at a multiple of BlockAlignment, returns the offset of the block.
+		size_t Serialize(std::vector<char>& buffer) const;
+
+		// Uses the block at offset in the mapped file in place, the tree keeps the mapping alive. Processes that attach to the same file share its pages.
+		// Returns false when the block does not fit the mapping, was written with another node layout or leaf width, is not over nrPrimitives primitives,
+		// or has a node or primitive index that points outside of it. Validating reads the whole block once.
+		// Refitting an attached tree first copies it out of the mapping, building one drops the mapping.
+		bool Attach(std::shared_ptr<const MappedFile> pMapping, size_t offset, uint32_t nrPrimitives);
+#pragma endregion
+
+		// Refit the node bounds bottom-up after the primitives moved, keeping the tree topology.
+		// Falls back to a full build when the primitive count changed or the refitted tree degraded too far.
+		void Refit(const std::vector<Vector3>& positions, const std::vector<int>& indices);
+		void Refit(const std::vector<Vector3>& primitiveMins, const std::vector<Vector3>& primitiveMaxs);
+
+		// SAH cost of the whole tree relative to the root surface area, lower is better.
+		float CalculateCost() const;
+
+		uint32_t GetLeafWidth() const { return m_LeafWidth; }
+
+	private:
+		std::shared_ptr<const MappedFile> m_pMapping{};
+		const BVHNode* m_pMappedNodes{};
+		const uint32_t* m_pMappedPrimitiveIndices{};
+		uint32_t m_MappedPrimitiveCount{};
+
+		std::vector<Vector3> m_PrimitiveMins{};
+		std::vector<Vector3> m_PrimitiveMaxs{};
+		std::vector<Vector3> m_Centroids{};
+		// Morton mode: the code of the primitive in every slot of primitiveIndices, sorted
+		std::vector<uint32_t> m_MortonCodes{};
+		float m_BuildCost{};
+		uint32_t m_LeafWidth{ 1 };
+		BuildMode m_BuildMode{ BuildMode::SAH };
+		ThreadPool* m_pThreadPool{};
+
+		// Copies an attached tree into the vectors so it can be changed
+		void Detach();
+		void BuildFromBounds();
+		void RefitFromBounds();
+		void CalculateTriangleBounds(const std::vector<Vector3>& positions, const std::vector<int>& indices);
+		void UpdateNodeBounds(BVHNode& node) const;
+		void SortByMortonCode();
+		// The builders take the node array to allocate children from, so subtrees can be built into arrays of their own.
+		void Subdivide(std::vector<BVHNode>& targetNodes, uint32_t& targetNodesUsed, uint32_t nodeIndex, int depth);
+		void SubdivideParallel();
+		// Gives the node two children, returns false when it stays a leaf
+		bool SplitNode(std::vector<BVHNode>& targetNodes, uint32_t& targetNodesUsed, uint32_t nodeIndex, int depth);
+		// Number of primitives that go to the left child, 0 when the node should stay a leaf
+		uint32_t PartitionSAH(const BVHNode& node);
+		uint32_t FindMortonSplit(const BVHNode& node) const;
+		float FindBestSplit(const BVHNode& node, int& axis, float& splitPosition) const;
+		// Number of leafWidth sized groups the primitives take up, the intersection cost of a leaf.
+		uint32_t GetLeafGroups(uint32_t primitiveCount) const { return (primitiveCount + m_LeafWidth - 1) / m_LeafWidth; }
+	};
+
+	namespace BVHUtils
+	{
+		inline float GetSurfaceArea(const Vector3& minAABB, const Vector3& maxAABB)
+		{
+			const Vector3 extent = maxAABB - minAABB;
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	}
+}
@@ -0,0 +1,147 @@
+#include "BVH8.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace dae {
+	void BVH8::Build(const BVH& bvh)
+	{
+		nodes.clear();
+		if (bvh.IsEmpty())
+			return;
+
+		const BVHNode* pBinaryNodes = bvh.GetNodes();
+		const BVHNode& binaryRoot = pBinaryNodes[0];
+		const PendingChild root = binaryRoot.IsLeaf()
+			? PendingChild{ binaryRoot.minAABB, binaryRoot.maxAABB, UINT32_MAX, binaryRoot.leftFirst, binaryRoot.primitiveCount }
+			: PendingChild{ binaryRoot.minAABB, binaryRoot.maxAABB, 0, 0, 0 };
+
+		// Most nodes take the place of a handful of binary ones
+		nodes.reserve(bvh.nodesUsed / 4 + 1);
+		nodes.emplace_back();
+
+		PendingChild children[Width];
+		uint32_t childCount = 0;
+		if (root.IsRange() && root.primitiveCount <= MaxLeafSize)
+			children[childCount++] = root;
+		else
+			CollectChildren(pBinaryNodes, root, children, childCount);
+		WriteNode(pBinaryNodes, 0, children, childCount);
+	}
+
+	// Expands a binary inner node into up to Width of its descendants, always opening the largest inner node first.
+	// An oversized range is cut into chunks instead, they keep its bounds.
+	void BVH8::CollectChildren(const BVHNode* pBinaryNodes, const PendingChild& parent, PendingChild* pChildren, uint32_t& childCount) const
+	{
+		childCount = 0;
+		if (parent.IsRange()) {
+			const uint32_t nrChunks = std::min(Width, (parent.primitiveCount + MaxLeafSize - 1) / MaxLeafSize);
+			uint32_t firstSlot = parent.firstSlot;
+			for (uint32_t chunk = 0; chunk < nrChunks; chunk++) {
+				const uint32_t endSlot = parent.firstSlot + uint32_t(uint64_t(parent.primitiveCount) * (chunk + 1) / nrChunks);
+				pChildren[childCount++] = { parent.minAABB, parent.maxAABB, UINT32_MAX, firstSlot, endSlot - firstSlot };
+				firstSlot = endSlot;
+			}
+			return;
+		}
+
+		const auto toPendingChild = [pBinaryNodes](uint32_t binaryNodeIndex) {
+			const BVHNode& node = pBinaryNodes[binaryNodeIndex];
+			if (node.IsLeaf())
+				return PendingChild{ node.minAABB, node.maxAABB, UINT32_MAX, node.leftFirst, node.primitiveCount };
+			return PendingChild{ node.minAABB, node.maxAABB, binaryNodeIndex, 0, 0 };
+		};
+
+		const BVHNode& parentNode = pBinaryNodes[parent.binaryNodeIndex];
+		pChildren[childCount++] = toPendingChild(parentNode.leftFirst);
+		pChildren[childCount++] = toPendingChild(parentNode.leftFirst + 1);
+
+		while (childCount < Width) {
+			uint32_t largestChild = UINT32_MAX;
+			float largestArea = -1.f;
+			for (uint32_t child = 0; child < childCount; child++) {
+				if (pChildren[child].IsRange())
+					continue;
+				const float area = BVHUtils::GetSurfaceArea(pChildren[child].minAABB, pChildren[child].maxAABB);
+				if (area > largestArea) {
+					largestArea = area;
+					largestChild = child;
+				}
+			}
+			if (largestChild == UINT32_MAX)
+				break;
+
+			const BVHNode& node = pBinaryNodes[pChildren[largestChild].binaryNodeIndex];
+			pChildren[largestChild] = toPendingChild(node.leftFirst);
+			pChildren[childCount++] = toPendingChild(node.leftFirst + 1);
+		}
+	}
+
+	void BVH8::WriteNode(const BVHNode* pBinaryNodes, uint32_t nodeIndex, PendingChild* pChildren, uint32_t childCount)
+	{
+		Vector3 minAABB{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 maxAABB{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t child = 0; child < childCount; child++) {
+			minAABB = Vector3::Min(minAABB, pChildren[child].minAABB);
+			maxAABB = Vector3::Max(maxAABB, pChildren[child].maxAABB);
+		}
+
+		BVH8Node node{};
+		node.origin = minAABB;
+		node.childCount = static_cast<uint8_t>(childCount);
+
+		uint8_t* pQuantizedMins[3]{ node.minX, node.minY, node.minZ };
+		uint8_t* pQuantizedMaxs[3]{ node.maxX, node.maxY, node.maxZ };
+		for (int axis = 0; axis < 3; axis++) {
+			const float origin = minAABB[axis];
+
+			// Smallest power of two step whose 255 steps cover the node, also after rounding the addition
+			int exponent{};
+			std::frexp((maxAABB[axis] - origin) / 255.f, &exponent);
+			node.exponents[axis] = static_cast<int8_t>(std::clamp(exponent, -126, 127));
+			while (node.exponents[axis] < 127 && origin + 255.f * node.GetStep(axis) < maxAABB[axis])
+				node.exponents[axis]++;
+			const float step = node.GetStep(axis);
+
+			// Rounded outwards, checked with the same arithmetic the traversal dequantizes with
+			for (uint32_t child = 0; child < childCount; child++) {
+				const float childMin = pChildren[child].minAABB[axis];
+				const float childMax = pChildren[child].maxAABB[axis];
+
+				int quantizedMin = std::clamp(static_cast<int>(std::floor((childMin - origin) / step)), 0, 255);
+				while (quantizedMin > 0 && origin + static_cast<float>(quantizedMin) * step > childMin)
+					quantizedMin--;
+				int quantizedMax = std::clamp(static_cast<int>(std::ceil((childMax - origin) / step)), 0, 255);
+				while (quantizedMax < 255 && origin + static_cast<float>(quantizedMax) * step < childMax)
+					quantizedMax++;
+
+				pQuantizedMins[axis][child] = static_cast<uint8_t>(quantizedMin);
+				pQuantizedMaxs[axis][child] = static_cast<uint8_t>(quantizedMax);
+			}
+		}
+
+		// Inner children get consecutive nodes, they are written once this node is
+		uint32_t innerChildren[Width]{};
+		uint32_t nrInnerChildren = 0;
+		for (uint32_t child = 0; child < childCount; child++) {
+			const PendingChild& pendingChild = pChildren[child];
+			if (pendingChild.IsRange() && pendingChild.primitiveCount <= MaxLeafSize) {
+				node.children[child] = pendingChild.firstSlot;
+				node.primitiveCounts[child] = static_cast<uint8_t>(pendingChild.primitiveCount);
+				continue;
+			}
+
+			node.children[child] = static_cast<uint32_t>(nodes.size());
+			nodes.emplace_back();
+			innerChildren[nrInnerChildren++] = child;
+		}
+		nodes[nodeIndex] = node;
+
+		for (uint32_t innerChild = 0; innerChild < nrInnerChildren; innerChild++) {
+			PendingChild grandChildren[Width];
+			uint32_t grandChildCount = 0;
+			CollectChildren(pBinaryNodes, pChildren[innerChildren[innerChild]], grandChildren, grandChildCount);
+			WriteNode(pBinaryNodes, node.children[innerChildren[innerChild]], grandChildren, grandChildCount);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "BVH.h"
+
+namespace dae
+{
+	// The tree a mesh is traversed through
+	enum class BVHLayout : uint8_t
+	{
+		Binary,
+		// The binary tree collapsed into a BVH8, built from it after every build or refit
+		Wide8
+	};
+
+	// Eight children per node, their bounds stored in 8 bits per plane on a grid over the node's own bounds.
+	// The grid has its corner at origin and a power of two step per axis, so dequantizing (origin + q * step) is exact up to the one addition.
+	struct BVH8Node
+	{
+		Vector3 origin{};
+		int8_t exponents[3]{};
+		// Children are packed in the first childCount lanes
+		uint8_t childCount{};
+
+		uint8_t minX[8]{}, minY[8]{}, minZ[8]{};
+		uint8_t maxX[8]{}, maxY[8]{}, maxZ[8]{};
+
+		// Inner child: index of its node. Leaf child: first slot in BVH::primitiveIndices.
+		uint32_t children[8]{};
+		// Number of primitives of a leaf child, 0 for an inner child
+		uint8_t primitiveCounts[8]{};
+
+		float GetStep(int axis) const { return std::bit_cast<float>(uint32_t(exponents[axis] + 127) << 23); }
+	};
+
+	// Wide, compressed copy of a binary BVH: binary subtrees are collapsed into nodes of up to eight children.
+	// Keeps the primitive order of the binary tree, so the leaves refer to the same slots and the same packed triangles.
+	// A fraction of the binary tree's memory, and one node visit tests eight boxes at once.
+	struct BVH8
+	{
+		static constexpr uint32_t Width = 8;
+		// Leaves with more primitives than fit a primitive count are spread over extra nodes
+		static constexpr uint32_t MaxLeafSize = 255;
+		// Collapsing never adds levels, except the ones that spread the largest leaves
+		static constexpr int MaxDepth = BVH::MaxDepth + 8;
+		// Every level on the way down leaves at most Width - 1 children on the traversal stack
+		static constexpr int StackSize = (Width - 1) * MaxDepth + 1;
+
+		std::vector<BVH8Node> nodes{};
+
+		const BVH8Node* GetNodes() const { return nodes.data(); }
+		bool IsEmpty() const { return nodes.empty(); }
+
+		// Collapses the binary tree, again after every build or refit of it
+		void Build(const BVH& bvh);
+
+	private:
+		// A child before it is written: a binary inner node, or a range of slots with the bounds of the leaf it came from
+		struct PendingChild
+		{
+			Vector3 minAABB;
+			Vector3 maxAABB;
+			uint32_t binaryNodeIndex;
+			uint32_t firstSlot;
+			uint32_t primitiveCount;
+
+			bool IsRange() const { return binaryNodeIndex == UINT32_MAX; }
+		};
+
+		void WriteNode(const BVHNode* pBinaryNodes, uint32_t nodeIndex, PendingChild* pChildren, uint32_t childCount);
+		void CollectChildren(const BVHNode* pBinaryNodes, const PendingChild& parent, PendingChild* pChildren, uint32_t& childCount) const;
+	};
+}
@@ -0,0 +1,580 @@
+//Micro benchmarks for the hot paths of the ray tracer, prints the average time per call.
+//Run without arguments to run all of them, or pass the names of the benchmarks to run.
+
+//Standard includes
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//Project includes
+#include "DataTypes.h"
+#include "Matrix.h"
+#include "MeshCache.h"
+#include "OBJLoader.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Utils.h"
+
+using namespace dae;
+
+namespace
+{
+	struct Benchmark
+	{
+		const char* name;
+		std::function<void()> run;
+	};
+
+	// Keeps the compiler from optimizing away work whose result is never used
+	volatile uint32_t g_Sink{};
+
+	// Runs the function for a number of repetitions and prints the average time per iteration, which it returns in nanoseconds.
+	double Measure(const char* label, uint32_t nrIterations, const std::function<uint32_t()>& function)
+	{
+		constexpr int nrRepetitions{ 5 };
+
+		// Warm up the caches first
+		g_Sink = g_Sink + function();
+
+		double bestNanoseconds{ DBL_MAX };
+		for (int repetition{}; repetition < nrRepetitions; ++repetition)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			g_Sink = g_Sink + function();
+			const auto end = std::chrono::steady_clock::now();
+
+			bestNanoseconds = std::min(bestNanoseconds, std::chrono::duration<double, std::nano>(end - start).count());
+		}
+
+		std::cout << "  " << std::left << std::setw(40) << label << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+			<< bestNanoseconds / nrIterations << " ns" << std::endl;
+		return bestNanoseconds / nrIterations;
+	}
+
+	Vector3 RandomVector(std::mt19937& generator, float min, float max)
+	{
+		std::uniform_real_distribution<float> distribution{ min, max };
+		return { distribution(generator), distribution(generator), distribution(generator) };
+	}
+
+	// Rays start around the origin and point into a box of geometry, so a fair share of them hits.
+	std::vector<Ray> CreateRays(std::mt19937& generator, uint32_t nrRays)
+	{
+		std::vector<Ray> rays(nrRays);
+		for (Ray& ray : rays)
+		{
+			ray.origin = RandomVector(generator, -1.f, 1.f);
+			ray.direction = (RandomVector(generator, -5.f, 5.f) + Vector3{ 0.f, 0.f, 10.f } - ray.origin).Normalized();
+		}
+		return rays;
+	}
+
+	// Rays from origin towards random points in the bounds of the mesh
+	std::vector<Ray> CreateRaysTowards(std::mt19937& generator, const TriangleMesh& mesh, const Vector3& origin, uint32_t nrRays)
+	{
+		std::vector<Ray> rays(nrRays);
+		for (Ray& ray : rays)
+		{
+			const Vector3 factor{ RandomVector(generator, 0.f, 1.f) };
+			const Vector3 target{
+				Lerpf(mesh.minAABB.x, mesh.maxAABB.x, factor.x),
+				Lerpf(mesh.minAABB.y, mesh.maxAABB.y, factor.y),
+				Lerpf(mesh.minAABB.z, mesh.maxAABB.z, factor.z)
+			};
+			ray.origin = origin;
+			ray.direction = (target - ray.origin).Normalized();
+		}
+		return rays;
+	}
+
+#pragma region Intersection
+	void BenchmarkHitTest_Sphere()
+	{
+		std::mt19937 generator{ 1234 };
+		const std::vector<Ray> rays{ CreateRays(generator, 1024) };
+
+		std::vector<Sphere> spheres(256);
+		for (Sphere& sphere : spheres)
+		{
+			sphere.origin = RandomVector(generator, -5.f, 5.f) + Vector3{ 0.f, 0.f, 10.f };
+			sphere.radius = std::uniform_real_distribution<float>{ 0.2f, 1.5f }(generator);
+		}
+
+		const uint32_t nrTests{ uint32_t(rays.size() * spheres.size()) };
+		Measure("HitTest_Sphere (closest hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				HitRecord hitRecord{};
+				for (const Sphere& sphere : spheres)
+					nrHits += GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord);
+			}
+			return nrHits;
+			});
+
+		Measure("HitTest_Sphere (any hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				for (const Sphere& sphere : spheres)
+					nrHits += GeometryUtils::HitTest_Sphere(sphere, ray);
+			}
+			return nrHits;
+			});
+
+		Measure("Occludes_Sphere", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				for (const Sphere& sphere : spheres)
+					nrHits += GeometryUtils::Occludes_Sphere(sphere, ray);
+			}
+			return nrHits;
+			});
+	}
+
+	void BenchmarkHitTest_Triangle()
+	{
+		std::mt19937 generator{ 5678 };
+		const std::vector<Ray> rays{ CreateRays(generator, 1024) };
+
+		std::vector<Triangle> triangles{};
+		triangles.reserve(256);
+		for (int i{}; i < 256; ++i)
+		{
+			const Vector3 center{ RandomVector(generator, -5.f, 5.f) + Vector3{ 0.f, 0.f, 10.f } };
+			Triangle triangle{ center + RandomVector(generator, -1.f, 1.f), center + RandomVector(generator, -1.f, 1.f), center + RandomVector(generator, -1.f, 1.f) };
+			triangle.cullMode = TriangleCullMode::NoCulling;
+			triangles.push_back(triangle);
+		}
+
+		const uint32_t nrTests{ uint32_t(rays.size() * triangles.size()) };
+		Measure("HitTest_Triangle (closest hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				HitRecord hitRecord{};
+				for (const Triangle& triangle : triangles)
+					nrHits += GeometryUtils::HitTest_Triangle(triangle, ray, hitRecord);
+			}
+			return nrHits;
+			});
+
+		Measure("HitTest_Triangle (any hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				for (const Triangle& triangle : triangles)
+					nrHits += GeometryUtils::HitTest_Triangle(triangle, ray);
+			}
+			return nrHits;
+			});
+
+		Measure("Occludes_Triangle", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				for (const Triangle& triangle : triangles)
+					nrHits += GeometryUtils::Occludes_Triangle(triangle, ray);
+			}
+			return nrHits;
+			});
+	}
+
+	// Rays from the bunny scene camera towards random points in the bounds of the mesh, through the BVH and the leaf kernel.
+	void BenchmarkHitTest_TriangleMesh()
+	{
+		TriangleMesh mesh{};
+		mesh.cullMode = TriangleCullMode::BackFaceCulling;
+		if (!Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", mesh))
+		{
+			std::cout << "  Resources/lowpoly_bunny2.obj not found, run from the build directory" << std::endl;
+			return;
+		}
+		mesh.UpdateTransforms();
+
+		std::mt19937 generator{ 91011 };
+		const std::vector<Ray> rays{ CreateRaysTowards(generator, mesh, Vector3{ 0.f, 1.f, -5.f }, 4096) };
+
+		const uint32_t nrTests{ uint32_t(rays.size()) };
+		Measure("HitTest_TriangleMesh (closest hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+			{
+				HitRecord hitRecord{};
+				nrHits += GeometryUtils::HitTest_TriangleMesh(mesh, ray, hitRecord);
+			}
+			return nrHits;
+			});
+
+		Measure("HitTest_TriangleMesh (any hit)", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+				nrHits += GeometryUtils::HitTest_TriangleMesh(mesh, ray);
+			return nrHits;
+			});
+
+		Measure("Occludes_TriangleMesh", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : rays)
+				nrHits += GeometryUtils::Occludes_TriangleMesh(mesh, ray);
+			return nrHits;
+			});
+
+		// The leaf kernels on their own, over every packed triangle without the BVH
+		const PackedTriangles& triangles{ mesh.packedTriangles };
+		const uint32_t nrTriangleTests{ uint32_t(256 * triangles.triangleCount) };
+		Measure("HitTest_PackedTriangle (per triangle)", nrTriangleTests, [&]() {
+			uint32_t nrHits{};
+			for (uint32_t rayIndex{}; rayIndex < 256; ++rayIndex)
+			{
+				HitRecord hitRecord{};
+				for (uint32_t slot{}; slot < triangles.triangleCount; ++slot)
+					nrHits += GeometryUtils::HitTest_PackedTriangle(triangles, slot, mesh.cullMode, rays[rayIndex], hitRecord);
+			}
+			return nrHits;
+			});
+
+		Measure("HitTest_PackedTriangles (per triangle)", nrTriangleTests, [&]() {
+			uint32_t nrHits{};
+			for (uint32_t rayIndex{}; rayIndex < 256; ++rayIndex)
+			{
+				HitRecord hitRecord{};
+				uint32_t hitSlot{};
+				for (uint32_t slot{}; slot < triangles.triangleCount; slot += SIMD::FloatN::Width)
+					nrHits += GeometryUtils::HitTest_PackedTriangles(triangles, slot, std::min(SIMD::FloatN::Width, triangles.triangleCount - slot),
+						mesh.cullMode, rays[rayIndex], hitRecord, hitSlot);
+			}
+			return nrHits;
+			});
+	}
+#pragma endregion
+#pragma region Scene
+	// Shadow rays of a scene, from every camera hit of a 160x120 frame to every light
+	template<typename SceneType>
+	void MeasureShadowRays(const char* label)
+	{
+		const int width{ 160 }, height{ 120 };
+
+		SceneType scene{};
+		scene.Initialize();
+		scene.UpdateAccelerationStructure();
+
+		Camera& camera = scene.GetCamera();
+		const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+		const float aspectRatio = width / static_cast<float>(height);
+		const float fov = tan(camera.fovAngle * TO_RADIANS / 2.f);
+
+		std::vector<Ray> shadowRays{};
+		std::vector<size_t> lightIndices{};
+		for (int py{}; py < height; ++py)
+		{
+			for (int px{}; px < width; ++px)
+			{
+				const float cx{ (2 * ((px + 0.5f) / float(width)) - 1) * aspectRatio * fov };
+				const float cy{ (1 - (2 * ((py + 0.5f) / float(height)))) * fov };
+				HitRecord hit{};
+				scene.GetClosestHit(Ray{ camera.origin, cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized() }, hit);
+				if (!hit.didHit)
+					continue;
+
+				for (size_t lightIndex{}; lightIndex < scene.GetLights().size(); ++lightIndex)
+				{
+					shadowRays.push_back(scene.GetLights()[lightIndex].CreateLightRay(hit.origin));
+					lightIndices.push_back(lightIndex);
+				}
+			}
+		}
+
+		std::cout << "  " << label << ", " << shadowRays.size() << " shadow rays" << std::endl;
+		const uint32_t nrTests{ uint32_t(shadowRays.size()) };
+		Measure("Scene::DoesHit", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : shadowRays)
+				nrHits += scene.DoesHit(ray);
+			return nrHits;
+			});
+
+		Measure("Scene::IsOccluded", nrTests, [&]() {
+			uint32_t nrHits{};
+			for (const Ray& ray : shadowRays)
+				nrHits += scene.IsOccluded(ray);
+			return nrHits;
+			});
+
+		// Rays come in pixel order, like a tile renders them
+		Measure("Scene::IsOccluded (occluder cache)", nrTests, [&]() {
+			ShadowCache shadowCache{};
+			uint32_t nrHits{};
+			for (size_t rayIndex{}; rayIndex < shadowRays.size(); ++rayIndex)
+				nrHits += scene.IsOccluded(shadowRays[rayIndex], &shadowCache, lightIndices[rayIndex]);
+			return nrHits;
+			});
+	}
+
+	void BenchmarkShadowRays()
+	{
+		MeasureShadowRays<Scene_W4>("Scene_W4");
+		MeasureShadowRays<Scene_W4_ReferenceScene>("Scene_W4_ReferenceScene");
+		MeasureShadowRays<Scene_W4_BunnyScene>("Scene_W4_BunnyScene");
+	}
+#pragma endregion
+#pragma region Loading
+	// A flat grid of quads, written as triangles in the plain "f a b c" form so ParseOBJ can read it as well
+	bool WriteGridOBJ(const std::string& filename, uint32_t nrQuadsPerSide)
+	{
+		std::ofstream file(filename);
+		if (!file)
+			return false;
+
+		const uint32_t nrVerticesPerSide{ nrQuadsPerSide + 1 };
+		for (uint32_t z{}; z < nrVerticesPerSide; ++z)
+			for (uint32_t x{}; x < nrVerticesPerSide; ++x)
+				file << "v " << float(x) / nrQuadsPerSide << " 0.000000 " << float(z) / nrQuadsPerSide << '\n';
+
+		for (uint32_t z{}; z < nrQuadsPerSide; ++z)
+		{
+			for (uint32_t x{}; x < nrQuadsPerSide; ++x)
+			{
+				const uint32_t corner{ z * nrVerticesPerSide + x + 1 };
+				file << "f " << corner << ' ' << corner + nrVerticesPerSide << ' ' << corner + 1 << '\n';
+				file << "f " << corner + 1 << ' ' << corner + nrVerticesPerSide << ' ' << corner + nrVerticesPerSide + 1 << '\n';
+			}
+		}
+		return bool(file);
+	}
+
+	// Time per triangle of loading the whole file, through the stream parser, the memory-mapped one and the mesh cache.
+	// The cached load includes the BVH the others leave to the first UpdateTransforms.
+	void MeasureLoad(const std::string& name, const std::string& filename)
+	{
+		TriangleMesh mesh{};
+		if (!Utils::LoadOBJ(filename, mesh))
+		{
+			std::cout << "  " << filename << " not found, run from the build directory" << std::endl;
+			return;
+		}
+		const uint32_t nrTriangles{ uint32_t(mesh.indices.size() / 3) };
+
+		Measure(("ParseOBJ " + name + " (per triangle)").c_str(), nrTriangles, [&]() {
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<int> indices{};
+			Utils::ParseOBJ(filename, positions, normals, indices);
+			return uint32_t(indices.size());
+			});
+
+		ThreadPool threadPool{};
+		Measure(("LoadOBJ " + name + " (per triangle)").c_str(), nrTriangles, [&]() {
+			TriangleMesh loadedMesh{};
+			Utils::LoadOBJ(filename, loadedMesh, &threadPool);
+			return uint32_t(loadedMesh.indices.size());
+			});
+
+		// The warm up call writes the cache, the timed ones read it
+		std::remove(Utils::GetMeshCacheFilename(filename).c_str());
+		Measure(("LoadOBJCached " + name + " (per triangle)").c_str(), nrTriangles, [&]() {
+			TriangleMesh loadedMesh{};
+			Utils::LoadOBJCached(filename, loadedMesh, &threadPool);
+			return uint32_t(loadedMesh.indices.size());
+			});
+	}
+
+	void BenchmarkLoadOBJ()
+	{
+		MeasureLoad("lowpoly_bunny2", "Resources/lowpoly_bunny2.obj");
+
+		const std::string gridFilename{ "benchmark_grid.obj" };
+		if (!WriteGridOBJ(gridFilename, 500))
+		{
+			std::cout << "  Could not write " << gridFilename << std::endl;
+			return;
+		}
+		MeasureLoad("grid_500k", gridFilename);
+		std::remove(gridFilename.c_str());
+		std::remove(Utils::GetMeshCacheFilename(gridFilename).c_str());
+	}
+#pragma endregion
+#pragma region Build
+	// Sphere with a bumpy radius, nrRings * nrSegments * 2 triangles. Stands in for a large scanned asset.
+	TriangleMesh CreateBumpySphere(uint32_t nrRings, uint32_t nrSegments)
+	{
+		TriangleMesh mesh{};
+		for (uint32_t ring{}; ring <= nrRings; ++ring)
+		{
+			const float theta{ PI * ring / nrRings };
+			for (uint32_t segment{}; segment <= nrSegments; ++segment)
+			{
+				const float phi{ PI_2 * segment / nrSegments };
+				const float radius{ 1.f + 0.05f * sinf(13.f * theta) * sinf(17.f * phi) + 0.02f * sinf(71.f * theta + 53.f * phi) };
+				mesh.positions.push_back(Vector3{ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) } * radius);
+			}
+		}
+
+		const int nrColumns{ int(nrSegments) + 1 };
+		for (int ring{}; ring < int(nrRings); ++ring)
+		{
+			for (int segment{}; segment < int(nrSegments); ++segment)
+			{
+				const int corner{ ring * nrColumns + segment };
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + 1, corner + nrColumns });
+				mesh.indices.insert(mesh.indices.end(), { corner + 1, corner + nrColumns + 1, corner + nrColumns });
+			}
+		}
+		mesh.CalculateNormals();
+		return mesh;
+	}
+
+	// Build time against the quality of the tree: its SAH cost and the time of a closest hit query through it
+	void MeasureBuild(const std::string& name, const TriangleMesh& sourceMesh, const Vector3& rayOrigin)
+	{
+		ThreadPool threadPool{};
+		const uint32_t nrTriangles{ uint32_t(sourceMesh.indices.size() / 3) };
+		std::cout << "  " << name << ": " << nrTriangles << " triangles, " << threadPool.GetNrThreads() << " threads" << std::endl;
+
+		struct Configuration
+		{
+			const char* label;
+			BVH::BuildMode buildMode;
+			bool isParallel;
+		};
+		const Configuration configurations[]{
+			{ "SAH", BVH::BuildMode::SAH, false },
+			{ "SAH parallel", BVH::BuildMode::SAH, true },
+			{ "Morton", BVH::BuildMode::Morton, false },
+			{ "Morton parallel", BVH::BuildMode::Morton, true },
+		};
+
+		for (const Configuration& configuration : configurations)
+		{
+			TriangleMesh mesh{ sourceMesh };
+			mesh.bvh.SetBuildMode(configuration.buildMode);
+			mesh.bvh.SetThreadPool(configuration.isParallel ? &threadPool : nullptr);
+
+			Measure((std::string{ configuration.label } + " build (per triangle)").c_str(), nrTriangles, [&]() {
+				mesh.bvh.Build(mesh.positions, mesh.indices);
+				return mesh.bvh.nodesUsed;
+				});
+
+			// Refits the last build without changing it and packs the triangles in its order
+			mesh.UpdateTransforms();
+
+			std::mt19937 generator{ 1213 };
+			const std::vector<Ray> rays{ CreateRaysTowards(generator, mesh, rayOrigin, 4096) };
+			Measure((std::string{ configuration.label } + " closest hit (per ray)").c_str(), uint32_t(rays.size()), [&]() {
+				uint32_t nrHits{};
+				for (const Ray& ray : rays)
+				{
+					HitRecord hitRecord{};
+					nrHits += GeometryUtils::HitTest_TriangleMesh(mesh, ray, hitRecord);
+				}
+				return nrHits;
+				});
+
+			std::cout << "  " << std::left << std::setw(40) << (std::string{ configuration.label } + " tree (SAH cost)") << std::right << std::setw(10)
+				<< std::fixed << std::setprecision(2) << mesh.bvh.CalculateCost() << std::endl;
+		}
+	}
+
+	void BenchmarkBuild()
+	{
+		TriangleMesh bunny{};
+		if (Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", bunny))
+			MeasureBuild("lowpoly_bunny2", bunny, Vector3{ 0.f, 1.f, -5.f });
+		else
+			std::cout << "  Resources/lowpoly_bunny2.obj not found, run from the build directory" << std::endl;
+
+		MeasureBuild("bumpy sphere", CreateBumpySphere(512, 512), Vector3{ 0.f, 0.5f, -4.f });
+	}
+#pragma endregion
+#pragma region BVH8
+	// Binary against wide BVH on the same tree: the memory the nodes and primitive indices take per triangle, and the rays they trace per second
+	void MeasureBVHLayouts(const std::string& name, const TriangleMesh& sourceMesh, const Vector3& rayOrigin)
+	{
+		const uint32_t nrTriangles{ uint32_t(sourceMesh.indices.size() / 3) };
+		std::cout << "  " << name << ": " << nrTriangles << " triangles" << std::endl;
+
+		for (BVHLayout bvhLayout : { BVHLayout::Binary, BVHLayout::Wide8 })
+		{
+			TriangleMesh mesh{ sourceMesh };
+			mesh.bvhLayout = bvhLayout;
+			mesh.UpdateTransforms();
+
+			const std::string label{ bvhLayout == BVHLayout::Binary ? "BVH2" : "BVH8" };
+			const size_t nodeBytes{ bvhLayout == BVHLayout::Binary ? mesh.bvh.nodesUsed * sizeof(BVHNode) : mesh.bvh8.nodes.size() * sizeof(BVH8Node) };
+			const size_t bytes{ nodeBytes + mesh.bvh.GetPrimitiveCount() * sizeof(uint32_t) };
+			std::cout << "  " << std::left << std::setw(40) << (label + " memory (per triangle)") << std::right << std::setw(10)
+				<< std::fixed << std::setprecision(2) << double(bytes) / nrTriangles << " bytes" << std::endl;
+
+			std::mt19937 generator{ 1819 };
+			const std::vector<Ray> rays{ CreateRaysTowards(generator, mesh, rayOrigin, 4096) };
+			const auto printRaysPerSecond = [&label](const char* query, double nanosecondsPerRay) {
+				std::cout << "  " << std::left << std::setw(40) << (label + " " + query + " (per second)") << std::right << std::setw(10)
+					<< std::fixed << std::setprecision(2) << 1e3 / nanosecondsPerRay << " Mrays" << std::endl;
+			};
+
+			printRaysPerSecond("closest hit", Measure((label + " closest hit (per ray)").c_str(), uint32_t(rays.size()), [&]() {
+				uint32_t nrHits{};
+				for (const Ray& ray : rays)
+				{
+					HitRecord hitRecord{};
+					nrHits += GeometryUtils::HitTest_TriangleMesh(mesh, ray, hitRecord);
+				}
+				return nrHits;
+				}));
+			printRaysPerSecond("occlusion", Measure((label + " occlusion (per ray)").c_str(), uint32_t(rays.size()), [&]() {
+				uint32_t nrHits{};
+				for (const Ray& ray : rays)
+					nrHits += GeometryUtils::Occludes_TriangleMesh(mesh, ray);
+				return nrHits;
+				}));
+		}
+	}
+
+	void BenchmarkBVH8()
+	{
+		TriangleMesh bunny{};
+		if (Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", bunny))
+			MeasureBVHLayouts("lowpoly_bunny2", bunny, Vector3{ 0.f, 1.f, -5.f });
+		else
+			std::cout << "  Resources/lowpoly_bunny2.obj not found, run from the build directory" << std::endl;
+
+		MeasureBVHLayouts("bumpy sphere", CreateBumpySphere(512, 512), Vector3{ 0.f, 0.5f, -4.f });
+	}
+#pragma endregion
+}
+
+int main(int argc, char* args[])
+{
+	const std::vector<Benchmark> benchmarks{
+		{ "sphere", BenchmarkHitTest_Sphere },
+		{ "triangle", BenchmarkHitTest_Triangle },
+		{ "mesh", BenchmarkHitTest_TriangleMesh },
+		{ "shadow", BenchmarkShadowRays },
+		{ "obj", BenchmarkLoadOBJ },
+		{ "build", BenchmarkBuild },
+		{ "bvh8", BenchmarkBVH8 },
+	};
+
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		bool selected{ argc < 2 };
+		for (int i{ 1 }; i < argc; ++i)
+			selected |= std::strcmp(args[i], benchmark.name) == 0;
+
+		if (!selected)
+			continue;
+
+		std::cout << benchmark.name << std::endl;
+		benchmark.run();
+	}
+
+	return 0;
+}
@@ -1,7 +1,9 @@
 #pragma once
 #include <cassert>
+#if !defined(HEADLESS)
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
+#endif
 #include <iostream>
 
 #include "Math.h"
@@ -11,8 +13,8 @@ namespace dae
 {
 	struct Camera
 	{
-		const float MOVEMENT_SPEED = 10.f;
-		const float ROTATION_SPEED = 4.f;
+		static constexpr float MOVEMENT_SPEED = 10.f;
+		static constexpr float ROTATION_SPEED = 4.f;
 
 		Camera() = default;
 
@@ -46,8 +48,31 @@ namespace dae
 			return {right, up, forward.Normalized(), origin};
 		}
 
-		void Update(Timer* pTimer)
+		//True while a key or mouse button that moves the camera is held, so the next Update will report a change.
+		//Reads the current input state, safe to call in the middle of a frame on the thread that owns the window.
+		bool HasInput() const
 		{
+#if defined(HEADLESS)
+			return false;
+#else
+			SDL_PumpEvents();
+			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
+			for (const SDL_Scancode key : { SDL_SCANCODE_W, SDL_SCANCODE_A, SDL_SCANCODE_S, SDL_SCANCODE_D, SDL_SCANCODE_Q, SDL_SCANCODE_E }) {
+				if (pKeyboardState[key] == 1)
+					return true;
+			}
+			return (SDL_GetMouseState(nullptr, nullptr) & (SDL_BUTTON(SDL_BUTTON_LEFT) | SDL_BUTTON(SDL_BUTTON_RIGHT))) != 0;
+#endif
+		}
+
+		//Returns true when the camera moved or turned
+		bool Update(Timer* pTimer)
+		{
+#if defined(HEADLESS)
+			//No input devices without a window, the camera stays where the scene put it
+			(void)pTimer;
+			return false;
+#else
 			const float deltaTime = pTimer->GetElapsed();
 
 			//Keyboard Input
@@ -60,6 +85,7 @@ namespace dae
 
 			// Transform Rotation:
 			bool rotated = false;
+			bool moved = false;
 			Vector3 movementDirection = {};
 			if ((mouseState & SDL_BUTTON(SDL_BUTTON_LEFT) && mouseState & SDL_BUTTON(SDL_BUTTON_RIGHT)) && abs(mouseY) > 1) {
 				movementDirection += mouseY > 0 ? up : -up;
@@ -107,16 +133,19 @@ namespace dae
 				movementDirection.Normalize();
 
 				origin += movementDirection * (deltaTime * MOVEMENT_SPEED);
+				moved = true;
 			}
 
 			else {
 				if (mouseState & SDL_BUTTON(SDL_BUTTON_LEFT) && abs(mouseY) > 0.001) {
 					float movementDist = mouseY > 0 ? SDL_clamp(mouseY / 800.f, -3, -1) : SDL_clamp(mouseY / 800.f, 1, 3);
 					origin += forward * (deltaTime * MOVEMENT_SPEED * movementDist);
+					moved = true;
 				}
 			}
 
-
+			return rotated || moved;
+#endif
 		}
 	};
 }
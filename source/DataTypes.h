@@ -1,5 +1,6 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
 
 #include "Math.h"
 #include "vector"
@@ -7,12 +8,15 @@
 namespace dae
 {
 #pragma region GEOMETRY
+	// Index into the scene's material table
+	using MaterialIndex = uint16_t;
+
 	struct Sphere
 	{
 		Vector3 origin{};
 		float radius{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialIndex materialIndex{ 0 };
 	};
 
 	struct Plane
@@ -20,7 +24,7 @@ namespace dae
 		Vector3 origin{};
 		Vector3 normal{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialIndex materialIndex{ 0 };
 	};
 
 	enum class TriangleCullMode
@@ -51,7 +55,7 @@ namespace dae
 		Vector3 normal{};
 
 		TriangleCullMode cullMode{};
-		unsigned char materialIndex{};
+		MaterialIndex materialIndex{};
 	};
 
 #pragma region MISC
@@ -65,6 +69,31 @@ namespace dae
 
 	};
 
+	// Primary rays of a block of pixels, one ray per SIMD lane. A pinhole camera gives every ray the same origin.
+	struct RayPacket
+	{
+		static constexpr uint32_t Size{ SIMD::FloatN::Width };
+		// Block of pixels a packet covers: 4x2 with 8 lanes, 2x2 with 4
+		static constexpr uint32_t Width{ Size >= 8 ? 4u : Size >= 4 ? 2u : 1u };
+		static constexpr uint32_t Height{ Size / Width };
+
+		Vector3 origin{};
+		float directionX[Size]{};
+		float directionY[Size]{};
+		float directionZ[Size]{};
+
+		float min{ 0.0001f };
+		float max{ FLT_MAX };
+
+		// Bit i is set when lane i holds a ray, blocks on the screen border leave lanes empty
+		uint32_t laneMask{};
+
+		Ray GetRay(uint32_t lane) const
+		{
+			return Ray{ origin, Vector3{ directionX[lane], directionY[lane], directionZ[lane] }, min, max };
+		}
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -72,7 +101,7 @@ namespace dae
 		float t = FLT_MAX;
 
 		bool didHit{ false };
-		unsigned char materialIndex{ 0 };
+		MaterialIndex materialIndex{ 0 };
 	};
 #pragma endregion
 }
\ No newline at end of file
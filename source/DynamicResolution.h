@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace dae
+{
+	// Picks the render scale that holds a target frame time while the view changes, and full resolution once it is still.
+	// Feed it the time of every frame together with whether the view changed, it returns the scale for the next frame.
+	class DynamicResolution final
+	{
+	public:
+		explicit DynamicResolution(float targetFrameTime, float minScale = 0.25f) :
+			m_TargetFrameTime(targetFrameTime), m_MinScale(minScale)
+		{
+		}
+
+		float Update(float frameTime, bool viewChanged)
+		{
+			// A still view gets every pixel, moving again continues at the scale that held the target before
+			if (!viewChanged) {
+				m_WasMoving = false;
+				m_NrFrameTimes = 0;
+				return 1.f;
+			}
+
+			// Only frames rendered at the current scale say anything about it
+			if (m_WasMoving)
+				m_FrameTimes[m_NrFrameTimes++] = frameTime;
+			m_WasMoving = true;
+
+			if (m_NrFrameTimes < NrFrameTimes)
+				return m_Scale;
+
+			float averageFrameTime{};
+			for (float time : m_FrameTimes)
+				averageFrameTime += time;
+			averageFrameTime /= NrFrameTimes;
+			m_NrFrameTimes = 0;
+
+			// Within the dead zone around the target the scale stays put, so it does not oscillate between two steps
+			if (std::abs(averageFrameTime - m_TargetFrameTime) < DeadZone * m_TargetFrameTime)
+				return m_Scale;
+
+			// The cost of a frame grows with its number of pixels, the square of the scale
+			const float scale{ m_Scale * std::sqrt(m_TargetFrameTime / averageFrameTime) };
+			m_Scale = std::clamp(std::round(scale / ScaleStep) * ScaleStep, m_MinScale, 1.f);
+			return m_Scale;
+		}
+
+		float GetScale() const { return m_Scale; }
+
+	private:
+		static constexpr uint32_t NrFrameTimes{ 4 };
+		static constexpr float DeadZone{ 0.1f };
+		// Scales are rounded to steps, so small changes in frame time do not resize the render target every few frames
+		static constexpr float ScaleStep{ 0.05f };
+
+		float m_TargetFrameTime;
+		float m_MinScale;
+		float m_Scale{ 1.f };
+
+		float m_FrameTimes[NrFrameTimes]{};
+		uint32_t m_NrFrameTimes{};
+		bool m_WasMoving{ false };
+	};
+}
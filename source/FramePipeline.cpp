@@ -0,0 +1,84 @@
+#include "FramePipeline.h"
+
+//Standard includes
+#include <algorithm>
+
+//Project includes
+#include "Renderer.h"
+#include "Scene.h"
+
+using namespace dae;
+
+FramePipeline::FramePipeline(Renderer* pRenderer, Scene* pFirstScene, Scene* pSecondScene) :
+	m_pRenderer(pRenderer),
+	m_pScenes{ pFirstScene, pSecondScene },
+	m_FrontBuffer(size_t(pRenderer->GetWidth()) * pRenderer->GetHeight())
+{
+	m_RenderThread = std::thread(&FramePipeline::RenderLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_Condition.notify_all();
+	m_RenderThread.join();
+}
+
+bool FramePipeline::WaitForFrame()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if (!m_pFrameScene)
+		return false;
+
+	m_Condition.wait(lock, [this]() { return !m_FrameInFlight; });
+	m_pFrameScene = nullptr;
+
+	const uint32_t* pPixels = m_pRenderer->GetBufferPixels();
+	std::copy(pPixels, pPixels + m_FrontBuffer.size(), m_FrontBuffer.begin());
+	return true;
+}
+
+void FramePipeline::StartFrame(bool refining)
+{
+	Scene* pFrameScene = m_pScenes[m_BackIndex];
+	m_BackIndex = 1 - m_BackIndex;
+
+	// Scenes only carry the camera from frame to frame, animations are driven by the timer's total time.
+	// Copied before the render thread starts reading the scene.
+	m_pScenes[m_BackIndex]->GetCamera() = pFrameScene->GetCamera();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_pFrameScene = pFrameScene;
+		m_FrameRefining = refining;
+		m_FrameInFlight = true;
+		m_CancelFrame.store(false);
+	}
+	m_Condition.notify_all();
+}
+
+void FramePipeline::RenderLoop()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true) {
+		m_Condition.wait(lock, [this]() { return m_Quit || m_FrameInFlight; });
+		if (m_Quit)
+			return;
+
+		Scene* pScene = m_pFrameScene;
+		const bool refining = m_FrameRefining;
+		lock.unlock();
+
+		if (refining)
+			m_pRenderer->RenderRefining(pScene, [this]() { return m_CancelFrame.load(); });
+		else
+			m_pRenderer->Render(pScene);
+
+		lock.lock();
+		m_FrameInFlight = false;
+		m_Condition.notify_all();
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+
+	// Overlaps updating frame N + 1 with rendering frame N on a render thread of its own.
+	// The scene is double-buffered: two instances of the same scene, the render thread reads the front one while the caller updates the back one.
+	// A finished frame is copied to a front buffer, so presenting or saving it does not hold up the next render.
+	//
+	// Every frame the caller updates GetBackScene(), calls WaitForFrame(), changes renderer settings if needed and calls StartFrame().
+	// The renderer is only safe to touch between WaitForFrame() and StartFrame().
+	class FramePipeline final
+	{
+	public:
+		FramePipeline(Renderer* pRenderer, Scene* pFirstScene, Scene* pSecondScene);
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline(FramePipeline&&) noexcept = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+		FramePipeline& operator=(FramePipeline&&) noexcept = delete;
+
+		// Scene of the next frame, the render thread does not touch it
+		Scene* GetBackScene() const { return m_pScenes[m_BackIndex]; }
+
+		// Waits for the frame in flight and copies it to the front buffer, returns false when no frame was in flight
+		bool WaitForFrame();
+		// Starts rendering the back scene, which becomes the front scene. The new back scene continues from its camera.
+		// With refining set the frame renders coarse to fine and can be dropped with CancelFrame.
+		void StartFrame(bool refining = false);
+		// Drops the frame in flight when it renders coarse to fine, the front buffer then gets its coarser levels
+		void CancelFrame() { m_CancelFrame.store(true); }
+
+		// The last finished frame, in the format of the renderer's buffer
+		const std::vector<uint32_t>& GetFrontBuffer() const { return m_FrontBuffer; }
+
+	private:
+		Renderer* m_pRenderer;
+		Scene* m_pScenes[2];
+		uint32_t m_BackIndex{ 0 };
+
+		std::vector<uint32_t> m_FrontBuffer{};
+
+		std::thread m_RenderThread{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		Scene* m_pFrameScene{};
+		bool m_FrameInFlight{ false };
+		bool m_FrameRefining{ false };
+		bool m_Quit{ false };
+		std::atomic<bool> m_CancelFrame{ false };
+
+		void RenderLoop();
+	};
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Visibility of a whole frame: the trace stage writes the primary hit of every pixel, the shading stage reads it back.
+	// Structure of arrays with one entry per pixel, it keeps only what shading needs of the hit record.
+	struct GBuffer
+	{
+		// Material id of the pixels whose primary ray hit nothing
+		static constexpr uint32_t NoHit{ UINT32_MAX };
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<uint32_t> materialIds{};
+
+		// Indices of the pixels that hit something, grouped by material and in raster order within a material.
+		// The pixels of material id are shadingOrder[materialOffsets[id]] up to materialOffsets[id + 1].
+		std::vector<uint32_t> shadingOrder{};
+		std::vector<uint32_t> materialOffsets{};
+
+		void Resize(size_t nrPixels)
+		{
+			positions.resize(nrPixels);
+			normals.resize(nrPixels);
+			materialIds.resize(nrPixels, NoHit);
+			shadingOrder.resize(nrPixels);
+		}
+
+		void Write(uint32_t pixelIndex, const HitRecord& hit)
+		{
+			positions[pixelIndex] = hit.origin;
+			normals[pixelIndex] = hit.normal;
+			materialIds[pixelIndex] = hit.didHit ? hit.materialIndex : NoHit;
+		}
+
+		HitRecord Read(uint32_t pixelIndex) const
+		{
+			HitRecord hit{};
+			hit.origin = positions[pixelIndex];
+			hit.normal = normals[pixelIndex];
+			hit.didHit = materialIds[pixelIndex] != NoHit;
+			hit.materialIndex = static_cast<decltype(hit.materialIndex)>(materialIds[pixelIndex]);
+			return hit;
+		}
+
+		uint32_t GetNrHits() const { return materialOffsets.empty() ? 0 : materialOffsets.back(); }
+
+		// Counting sort of the hit pixels on their material, nrMaterials bounds the material ids.
+		void SortByMaterial(size_t nrMaterials)
+		{
+			materialOffsets.assign(nrMaterials + 1, 0);
+			for (uint32_t materialId : materialIds) {
+				if (materialId != NoHit)
+					++materialOffsets[materialId + 1];
+			}
+			for (size_t id = 1; id <= nrMaterials; id++)
+				materialOffsets[id] += materialOffsets[id - 1];
+
+			// Fill every bucket from its start, materialOffsets[id] ends up at the start of the next bucket and is shifted back after
+			for (uint32_t pixelIndex = 0; pixelIndex < materialIds.size(); pixelIndex++) {
+				const uint32_t materialId = materialIds[pixelIndex];
+				if (materialId != NoHit)
+					shadingOrder[materialOffsets[materialId]++] = pixelIndex;
+			}
+			for (size_t id = nrMaterials; id > 0; id--)
+				materialOffsets[id] = materialOffsets[id - 1];
+			materialOffsets[0] = 0;
+		}
+	};
+}
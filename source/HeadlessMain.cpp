@@ -0,0 +1,164 @@
+//Offline renderer entry point: renders a scene into an in-memory framebuffer and writes every frame to disk.
+//Needs no window or display server, build with HEADLESS defined.
+
+//Standard includes
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//Project includes
+#include "Timer.h"
+#include "FramePipeline.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+using namespace dae;
+
+Scene* CreateScene(const std::string& sceneName)
+{
+	if (sceneName == "Scene_W1")				return new Scene_W1;
+	if (sceneName == "Scene_W2")				return new Scene_W2;
+	if (sceneName == "Scene_W3")				return new Scene_W3;
+	if (sceneName == "Scene_W4")				return new Scene_W4;
+	if (sceneName == "Scene_W4_ReferenceScene")	return new Scene_W4_ReferenceScene;
+	if (sceneName == "Scene_W4_BunnyScene")		return new Scene_W4_BunnyScene;
+	return nullptr;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: RayTracerHeadless <scene> <width> <height> <frames> [outputPrefix] [--progressive] [--adaptive] [--bvh8]\n";
+	std::cout << "  scene: Scene_W1, Scene_W2, Scene_W3, Scene_W4, Scene_W4_ReferenceScene, Scene_W4_BunnyScene\n";
+	std::cout << "  Frames are written as <outputPrefix>_0000.bmp, <outputPrefix>_0001.bmp, ... (prefix defaults to the scene name)\n";
+	std::cout << "  --progressive: accumulate jittered samples over the frames while the scene stays the same\n";
+	std::cout << "  --adaptive: extra samples on the edges and high contrast pixels of every frame\n";
+	std::cout << "  --bvh8: traverse the meshes through 8 wide BVHs with quantized bounds instead of binary ones\n";
+}
+
+int main(int argc, char* args[])
+{
+	if (argc < 5)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const std::string sceneName{ args[1] };
+	const int width{ std::atoi(args[2]) };
+	const int height{ std::atoi(args[3]) };
+	const int nrFrames{ std::atoi(args[4]) };
+	std::string outputPrefix{ sceneName };
+	bool progressive{ false };
+	bool adaptive{ false };
+	BVHLayout bvhLayout{ BVHLayout::Binary };
+	for (int i{ 5 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (arg == "--progressive")
+			progressive = true;
+		else if (arg == "--adaptive")
+			adaptive = true;
+		else if (arg == "--bvh8")
+			bvhLayout = BVHLayout::Wide8;
+		else
+			outputPrefix = arg;
+	}
+
+	if (width <= 0 || height <= 0 || nrFrames <= 0)
+	{
+		std::cerr << "Width, height and frames have to be positive numbers." << std::endl;
+		PrintUsage();
+		return 1;
+	}
+
+	//Double-buffered: one instance is updated for the next frame while the other one renders
+	const auto pScene = CreateScene(sceneName);
+	const auto pBackScene = CreateScene(sceneName);
+	if (!pScene || !pBackScene)
+	{
+		std::cerr << "Unknown scene: " << sceneName << std::endl;
+		PrintUsage();
+		return 1;
+	}
+
+	//Animated scenes are stepped at a fixed frame rate, so every run renders the same frames
+	constexpr float frameTime{ 1.f / 30.f };
+
+	const auto pTimer = new Timer();
+	const auto pRenderer = new Renderer(uint32_t(width), uint32_t(height));
+	pScene->SetThreadPool(&pRenderer->GetThreadPool());
+	pBackScene->SetThreadPool(&pRenderer->GetThreadPool());
+	pScene->SetBVHLayout(bvhLayout);
+	pBackScene->SetBVHLayout(bvhLayout);
+	pScene->Initialize();
+	pBackScene->Initialize();
+	if (progressive)
+		pRenderer->ToggleProgressive();
+	if (adaptive)
+		pRenderer->ToggleAdaptiveSampling();
+
+	int result{ 0 };
+	const auto startTime = std::chrono::steady_clock::now();
+	{
+		//Frame N + 1 is updated and frame N - 1 written to disk while frame N renders
+		FramePipeline pipeline{ pRenderer, pScene, pBackScene };
+		const auto saveFrame = [&](int frame)
+		{
+			std::ostringstream filename{};
+			filename << outputPrefix << '_' << std::setw(4) << std::setfill('0') << frame << ".bmp";
+			if (!Utils::WriteBMP(filename.str(), pipeline.GetFrontBuffer().data(), width, height))
+			{
+				std::cerr << "Could not write " << filename.str() << std::endl;
+				return false;
+			}
+			return true;
+		};
+
+		for (int frame{ 0 }; frame < nrFrames; ++frame)
+		{
+			const bool sceneChanged{ pipeline.GetBackScene()->Update(pTimer) };
+			pTimer->UpdateFixed(frameTime);
+
+			const bool hasFinishedFrame{ pipeline.WaitForFrame() };
+			if (sceneChanged)
+				pRenderer->ResetAccumulation();
+			pipeline.StartFrame();
+
+			if (hasFinishedFrame && !saveFrame(frame - 1))
+			{
+				result = 1;
+				break;
+			}
+		}
+
+		if (result == 0 && pipeline.WaitForFrame() && !saveFrame(nrFrames - 1))
+			result = 1;
+	}
+	const auto endTime = std::chrono::steady_clock::now();
+
+	const float totalSeconds{ std::chrono::duration<float>(endTime - startTime).count() };
+	std::cout << sceneName << " " << width << "x" << height << ": " << nrFrames << " frame(s) in " << totalSeconds << "s ("
+		<< totalSeconds * 1000.f / nrFrames << " ms/frame)" << std::endl;
+
+	if (progressive)
+		std::cout << "Progressive: " << pRenderer->GetNrAccumulatedFrames() << " sample(s) per pixel in the last frame" << std::endl;
+	if (adaptive)
+		std::cout << "Adaptive anti-aliasing: " << pRenderer->GetNrAdaptivePixels() << " pixel(s) refined in the last frame" << std::endl;
+
+	if (pRenderer->GetNrOccludedShadowRays() > 0)
+	{
+		std::cout << "Shadow occluder cache: " << pRenderer->GetNrOccludedShadowRays() << " of " << pRenderer->GetNrShadowRays() << " shadow rays blocked, "
+			<< pRenderer->GetNrShadowCacheHits() << " (" << std::fixed << std::setprecision(1)
+			<< 100.0 * pRenderer->GetNrShadowCacheHits() / pRenderer->GetNrOccludedShadowRays() << "%) by the cached occluder" << std::endl;
+	}
+
+	delete pScene;
+	delete pBackScene;
+	delete pRenderer;
+	delete pTimer;
+
+	return result;
+}
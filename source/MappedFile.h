@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	// Read-only view of a whole file, mapped into the address space instead of read into a buffer.
+	// The pages are shared with the file cache, so mapping the same file from several processes costs its memory once.
+	class MappedFile final
+	{
+	public:
+		// Tells the OS how the pages will be read, so it can read ahead or not
+		enum class Access
+		{
+			Sequential,
+			Random
+		};
+
+		explicit MappedFile(const std::string& filename, Access access = Access::Sequential);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		// False when the file could not be opened or mapped. An empty file is open, with no data.
+		bool IsOpen() const { return m_IsOpen; }
+
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{};
+		size_t m_Size{};
+		bool m_IsOpen{ false };
+
+#ifdef _WIN32
+		void* m_FileHandle{};
+		void* m_MappingHandle{};
+#else
+		int m_FileDescriptor{ -1 };
+#endif
+	};
+}
@@ -1,134 +1,126 @@
 #pragma once
+#include <cstdint>
+
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
 
 namespace dae
 {
-#pragma region Material BASE
-	class Material
+	enum class MaterialType : uint8_t
 	{
-	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence
 	};
-#pragma endregion
 
-#pragma region Material SOLID COLOR
-	//SOLID COLOR
-	//===========
-	class Material_SolidColor final : public Material
+	// One record of the scene's material table. Plain data: the type selects the shading kernel,
+	// every kernel only reads the fields of its own type. Create materials through the factory functions,
+	// they fill in the constants the kernels would otherwise recompute for every light and every hit.
+	struct Material
 	{
-	public:
-		Material_SolidColor(const ColorRGB& color): m_Color(color)
+		MaterialType type{ MaterialType::SolidColor };
+
+		// Solid color, diffuse color (Lambert, Lambert-Phong) or albedo (Cook-Torrence)
+		ColorRGB albedo{ colors::White };
+		float metalness{};
+		float roughness{}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+		float kd{};
+		float ks{};
+		float exponent{};
+
+		// Precomputed Cook-Torrence constants, see the factory
+		float alphaSquared{};
+		float k{};
+		ColorRGB f0{};
+
+#pragma region Material FACTORIES
+		static Material SolidColor(const ColorRGB& color)
 		{
+			Material material{};
+			material.type = MaterialType::SolidColor;
+			material.albedo = color;
+			return material;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
-		{
-			return m_Color;
-		}
-
-	private:
-		ColorRGB m_Color{colors::White};
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT
-	//LAMBERT
-	//=======
-	class Material_Lambert final : public Material
-	{
-	public:
-		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance){}
-
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		static Material Lambert(const ColorRGB& diffuseColor, float diffuseReflectance)
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			Material material{};
+			material.type = MaterialType::Lambert;
+			material.albedo = diffuseColor;
+			material.kd = diffuseReflectance;
+			return material;
 		}
 
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{1.f}; //kd
-	};
-#pragma endregion
-
-#pragma region Material LAMBERT PHONG
-	//LAMBERT-PHONG
-	//=============
-	class Material_LambertPhong final : public Material
-	{
-	public:
-		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent):
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
+		static Material LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent)
 		{
+			Material material{};
+			material.type = MaterialType::LambertPhong;
+			material.albedo = diffuseColor;
+			material.kd = kd;
+			material.ks = ks;
+			material.exponent = phongExponent;
+			return material;
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		static Material CookTorrence(const ColorRGB& albedo, float metalness, float roughness)
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor)
-				+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, v, hitRecord.normal);
+			Material material{};
+			material.type = MaterialType::CookTorrence;
+			material.albedo = albedo;
+			material.metalness = metalness;
+			material.roughness = roughness;
+
+			// UE4 remapping: alpha = roughness^2
+			const float alpha = Square(roughness);
+			material.alphaSquared = Square(alpha);
+			material.k = Square(alpha + 1) / 8.f;
+			material.f0 = (metalness == 0) ? ColorRGB{ 0.04f, 0.04f, 0.04f } : albedo;
+			return material;
 		}
-
-	private:
-		ColorRGB m_DiffuseColor{colors::White};
-		float m_DiffuseReflectance{0.5f}; //kd
-		float m_SpecularReflectance{0.5f}; //ks
-		float m_PhongExponent{1.f}; //Phong Exponent
-	};
 #pragma endregion
 
-#pragma region Material COOK TORRENCE
-	//COOK TORRENCE
-	class Material_CookTorrence final : public Material
-	{
-	public:
-		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness):
-			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
+		/**
+		 * \brief Function used to calculate the correct color for the material and its parameters
+		 * \param hitRecord current hitrecord
+		 * \param l light direction
+		 * \param v view direction
+		 * \return color
+		 */
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
+			switch (type) {
+			case MaterialType::Lambert:
+				return BRDF::Lambert(kd, albedo);
+			case MaterialType::LambertPhong:
+				return BRDF::Lambert(kd, albedo) + BRDF::Phong(ks, exponent, l, v, hitRecord.normal);
+			case MaterialType::CookTorrence:
+				return ShadeCookTorrence(hitRecord, l, v);
+			default:
+				return albedo;
+			}
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+	private:
+		ColorRGB ShadeCookTorrence(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
 		{
 			Vector3 h = Vector3::CreateHalfvector(l, -v).Normalized();
-			ColorRGB f0 = (m_Metalness == 0) ? ColorRGB{ 0.04f, 0.04f, 0.04f } : m_Albedo;
 
 			// Colour = NFG / 4(v*n)(l*n)
 			// Normal - Fresnel - Geometry, denominator reprojects factors.
 
 			ColorRGB fresnel = BRDF::FresnelFunction_Schlick(h, -v, f0);
-			ColorRGB nom =  fresnel *
-				BRDF::GeometryFunction_Smith(hitRecord.normal, -v, l, m_Roughness) *
-				BRDF::NormalDistribution_GGX(hitRecord.normal, h, m_Roughness);
+			ColorRGB nom = fresnel *
+				BRDF::GeometryFunction_Smith(hitRecord.normal, -v, l, k) *
+				BRDF::NormalDistribution_GGX(hitRecord.normal, h, alphaSquared);
 
 			float denom = 4.f * Vector3::Dot(-v, hitRecord.normal) * Vector3::Dot(l, hitRecord.normal);
 
 			ColorRGB specular = nom / denom;
-			ColorRGB kd = (m_Metalness == 0) ? ColorRGB{ 1, 1, 1 } - fresnel : ColorRGB{};
+			ColorRGB kdColor = (metalness == 0) ? ColorRGB{ 1, 1, 1 } - fresnel : ColorRGB{};
 
-			return BRDF::Lambert(kd, m_Albedo) + specular;
+			return BRDF::Lambert(kdColor, albedo) + specular;
 		}
-
-	private:
-		ColorRGB m_Albedo{0.955f, 0.637f, 0.538f}; //Copper
-		float m_Metalness{1.0f};
-		float m_Roughness{0.1f}; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
-#pragma endregion
 }
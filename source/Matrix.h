@@ -19,6 +19,7 @@ namespace dae {
 			const Vector4& t);
 
 		Matrix(const Matrix& m);
+		Matrix& operator=(const Matrix& m) = default;
 
 		Vector3 TransformVector(const Vector3& v) const;
 		Vector3 TransformVector(float x, float y, float z) const;
@@ -63,4 +64,49 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+
+	// Transforms only read the affine 3x4 part, with SIMD_MATH every row is one register.
+#pragma region Inline Definitions
+	inline Vector3 Matrix::TransformVector(const Vector3& v) const
+	{
+		return TransformVector(v[0], v[1], v[2]);
+	}
+
+	inline Vector3 Matrix::TransformVector(float x, float y, float z) const
+	{
+#if defined(SIMD_MATH)
+		const __m128 xAxis = _mm_mul_ps(_mm_loadu_ps(&data[0].x), _mm_set1_ps(x));
+		const __m128 yAxis = _mm_mul_ps(_mm_loadu_ps(&data[1].x), _mm_set1_ps(y));
+		const __m128 zAxis = _mm_mul_ps(_mm_loadu_ps(&data[2].x), _mm_set1_ps(z));
+		return SIMD::Store(_mm_add_ps(_mm_add_ps(xAxis, yAxis), zAxis));
+#else
+		return Vector3{
+			data[0].x * x + data[1].x * y + data[2].x * z,
+			data[0].y * x + data[1].y * y + data[2].y * z,
+			data[0].z * x + data[1].z * y + data[2].z * z
+		};
+#endif
+	}
+
+	inline Vector3 Matrix::TransformPoint(const Vector3& p) const
+	{
+		return TransformPoint(p[0], p[1], p[2]);
+	}
+
+	inline Vector3 Matrix::TransformPoint(float x, float y, float z) const
+	{
+#if defined(SIMD_MATH)
+		const __m128 xAxis = _mm_mul_ps(_mm_loadu_ps(&data[0].x), _mm_set1_ps(x));
+		const __m128 yAxis = _mm_mul_ps(_mm_loadu_ps(&data[1].x), _mm_set1_ps(y));
+		const __m128 zAxis = _mm_mul_ps(_mm_loadu_ps(&data[2].x), _mm_set1_ps(z));
+		return SIMD::Store(_mm_add_ps(_mm_add_ps(_mm_add_ps(xAxis, yAxis), zAxis), _mm_loadu_ps(&data[3].x)));
+#else
+		return Vector3{
+			data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+			data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+			data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+		};
+#endif
+	}
+#pragma endregion
+}
@@ -0,0 +1,266 @@
+#include "MeshCache.h"
+
+//Standard includes
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+//Project includes
+#include "MappedFile.h"
+#include "OBJLoader.h"
+#include "TriangleMesh.h"
+
+using namespace dae;
+
+namespace
+{
+	// Every value is written as its 4 or 8 little endian bytes, one after the other. Vectors are written per component,
+	// a Vector3 is padded to 16 bytes with SIMD_MATH, so the file does not depend on how the build lays it out.
+	//
+	// Header        magic, version, BVH leaf width, size and hash of the OBJ, number of positions and triangles, offset of the BVH
+	// Positions     x y z per position
+	// Indices       3 per triangle
+	// Normals       x y z per triangle
+	// BVH           the block of BVH::Serialize, used in place from the mapped file
+	static_assert(std::endian::native == std::endian::little, "The mesh cache is read and written in the byte order of the machine");
+
+	constexpr char Magic[8]{ 'D', 'A', 'E', 'M', 'E', 'S', 'H', '\0' };
+	constexpr uint32_t Version{ 2 };
+
+	constexpr size_t HeaderSize{ sizeof(Magic) + 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t) };
+	constexpr size_t VectorSize{ 3 * sizeof(float) };
+
+	struct Header
+	{
+		uint32_t leafWidth{};
+		uint64_t sourceSize{};
+		uint64_t sourceHash{};
+		uint32_t nrPositions{};
+		uint32_t nrTriangles{};
+		uint64_t bvhOffset{};
+	};
+
+	size_t GetMeshSize(const Header& header)
+	{
+		return HeaderSize + size_t(header.nrPositions) * VectorSize + size_t(header.nrTriangles) * (3 * sizeof(int32_t) + VectorSize);
+	}
+
+	// FNV-1a over 8 byte words with an extra shift to mix the high bits down, the tail byte by byte.
+	// Not a cryptographic hash, it only has to notice that the OBJ changed.
+	uint64_t HashContents(const char* pData, size_t size)
+	{
+		constexpr uint64_t Prime{ 0x100000001b3ull };
+		uint64_t hash{ 0xcbf29ce484222325ull };
+
+		size_t offset = 0;
+		for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+			uint64_t word{};
+			std::memcpy(&word, pData + offset, sizeof(word));
+			hash = (hash ^ word) * Prime;
+			hash ^= hash >> 32;
+		}
+		for (; offset < size; offset++)
+			hash = (hash ^ static_cast<uint8_t>(pData[offset])) * Prime;
+
+		return hash;
+	}
+
+#pragma region Writing
+	class Writer final
+	{
+	public:
+		explicit Writer(size_t size) { m_Buffer.reserve(size); }
+
+		template<typename T>
+		void Write(T value)
+		{
+			const char* pBytes = reinterpret_cast<const char*>(&value);
+			m_Buffer.insert(m_Buffer.end(), pBytes, pBytes + sizeof(T));
+		}
+
+		// Overwrites a value written earlier
+		template<typename T>
+		void WriteAt(size_t offset, T value)
+		{
+			std::memcpy(m_Buffer.data() + offset, &value, sizeof(T));
+		}
+
+		void Write(const Vector3& vector)
+		{
+			Write(vector.x);
+			Write(vector.y);
+			Write(vector.z);
+		}
+
+		std::vector<char>& GetBuffer() { return m_Buffer; }
+
+	private:
+		std::vector<char> m_Buffer{};
+	};
+
+	// Written under a name of its own and renamed when complete, so a process reading the cache never sees half of it
+	bool WriteCache(const std::string& cacheFilename, const Header& header, const TriangleMesh& mesh)
+	{
+		Writer writer{ GetMeshSize(header) };
+		for (char character : Magic)
+			writer.Write(character);
+		writer.Write(Version);
+		writer.Write(header.leafWidth);
+		writer.Write(header.sourceSize);
+		writer.Write(header.sourceHash);
+		writer.Write(header.nrPositions);
+		writer.Write(header.nrTriangles);
+		// The offset of the BVH, known once the mesh is written
+		const size_t bvhOffsetPosition = writer.GetBuffer().size();
+		writer.Write(uint64_t{});
+
+		for (const Vector3& position : mesh.positions)
+			writer.Write(position);
+		for (int index : mesh.indices)
+			writer.Write(static_cast<int32_t>(index));
+		for (const Vector3& normal : mesh.normals)
+			writer.Write(normal);
+
+		writer.WriteAt(bvhOffsetPosition, uint64_t(mesh.bvh.Serialize(writer.GetBuffer())));
+
+		const std::string temporaryFilename{ cacheFilename + "." + std::to_string(std::random_device{}()) + ".tmp" };
+		{
+			std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+			file.write(writer.GetBuffer().data(), static_cast<std::streamsize>(writer.GetBuffer().size()));
+			if (!file) {
+				file.close();
+				std::remove(temporaryFilename.c_str());
+				return false;
+			}
+		}
+
+		// Windows does not rename onto an existing file
+		if (std::rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0) {
+			std::remove(cacheFilename.c_str());
+			if (std::rename(temporaryFilename.c_str(), cacheFilename.c_str()) != 0) {
+				std::remove(temporaryFilename.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+#pragma endregion
+
+#pragma region Reading
+	class Reader final
+	{
+	public:
+		explicit Reader(const char* pData) : m_pData(pData) {}
+
+		template<typename T>
+		T Read()
+		{
+			T value{};
+			std::memcpy(&value, m_pData, sizeof(T));
+			m_pData += sizeof(T);
+			return value;
+		}
+
+		Vector3 ReadVector()
+		{
+			const float x = Read<float>();
+			const float y = Read<float>();
+			const float z = Read<float>();
+			return { x, y, z };
+		}
+
+	private:
+		const char* m_pData;
+	};
+
+	// Fills the mesh only when the whole cache checks out against the expected header.
+	// The BVH stays in the mapped file, the rest of the mesh is copied out.
+	bool ReadCache(const std::string& cacheFilename, const Header& expected, TriangleMesh& mesh)
+	{
+		// Traversal jumps all over the BVH
+		const auto pFile = std::make_shared<const MappedFile>(cacheFilename, MappedFile::Access::Random);
+		const MappedFile& file = *pFile;
+		if (!file.IsOpen() || file.GetSize() < HeaderSize || std::memcmp(file.GetData(), Magic, sizeof(Magic)) != 0)
+			return false;
+
+		Reader reader{ file.GetData() + sizeof(Magic) };
+		Header header{};
+		const uint32_t version = reader.Read<uint32_t>();
+		header.leafWidth = reader.Read<uint32_t>();
+		header.sourceSize = reader.Read<uint64_t>();
+		header.sourceHash = reader.Read<uint64_t>();
+		header.nrPositions = reader.Read<uint32_t>();
+		header.nrTriangles = reader.Read<uint32_t>();
+		header.bvhOffset = reader.Read<uint64_t>();
+
+		if (version != Version || header.leafWidth != expected.leafWidth
+			|| header.sourceSize != expected.sourceSize || header.sourceHash != expected.sourceHash)
+			return false;
+
+		// Checks the node layout, the size of the BVH block and every node and primitive index in it
+		BVH bvh{ header.leafWidth };
+		if (header.bvhOffset < GetMeshSize(header) || !bvh.Attach(pFile, header.bvhOffset, header.nrTriangles))
+			return false;
+
+		std::vector<Vector3> positions(header.nrPositions);
+		for (Vector3& position : positions)
+			position = reader.ReadVector();
+
+		std::vector<int> indices(size_t(header.nrTriangles) * 3);
+		for (int& index : indices) {
+			index = reader.Read<int32_t>();
+			if (index < 0 || uint32_t(index) >= header.nrPositions)
+				return false;
+		}
+
+		std::vector<Vector3> normals(header.nrTriangles);
+		for (Vector3& normal : normals)
+			normal = reader.ReadVector();
+
+		mesh.positions = std::move(positions);
+		mesh.indices = std::move(indices);
+		mesh.normals = std::move(normals);
+		mesh.bvh = std::move(bvh);
+		return true;
+	}
+#pragma endregion
+}
+
+std::string Utils::GetMeshCacheFilename(const std::string& filename)
+{
+	return filename + ".meshcache";
+}
+
+bool Utils::LoadOBJCached(const std::string& filename, TriangleMesh& mesh, ThreadPool* pThreadPool)
+{
+	Header header{};
+	header.leafWidth = mesh.bvh.GetLeafWidth();
+	{
+		const MappedFile source{ filename };
+		if (!source.IsOpen())
+			return false;
+
+		header.sourceSize = source.GetSize();
+		header.sourceHash = HashContents(source.GetData(), source.GetSize());
+	}
+
+	const std::string cacheFilename{ GetMeshCacheFilename(filename) };
+	if (ReadCache(cacheFilename, header, mesh))
+		return true;
+
+	if (!LoadOBJ(filename, mesh, pThreadPool))
+		return false;
+
+	// Built in object space, UpdateTransforms refits it to the transformed positions
+	mesh.bvh.Build(mesh.positions, mesh.indices);
+
+	header.nrPositions = static_cast<uint32_t>(mesh.positions.size());
+	header.nrTriangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+	WriteCache(cacheFilename, header, mesh);
+	return true;
+}
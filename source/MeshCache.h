@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	struct TriangleMesh;
+	class ThreadPool;
+
+	namespace Utils
+	{
+		// Binary cache of a loaded OBJ: positions, indices, face normals and the object space BVH, next to the OBJ as <filename>.meshcache.
+		// The BVH is used in place from the mapped cache, see BVH::Attach, the rest of the mesh is copied into its vectors.
+		// The cache is used when it matches the size and content hash of the OBJ and the leaf width of the mesh BVH,
+		// otherwise the OBJ is loaded with LoadOBJ and the cache is (re)written. Failing to write it is not an error.
+		// Returns false when the OBJ itself cannot be loaded.
+		bool LoadOBJCached(const std::string& filename, TriangleMesh& mesh, ThreadPool* pThreadPool = nullptr);
+
+		// Path of the cache LoadOBJCached uses for an OBJ
+		std::string GetMeshCacheFilename(const std::string& filename);
+	}
+}
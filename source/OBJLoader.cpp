@@ -0,0 +1,389 @@
+#include "OBJLoader.h"
+
+//Standard includes
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+//Project includes
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "TriangleMesh.h"
+
+using namespace dae;
+
+namespace
+{
+	// Files are split in chunks of at least this many bytes, smaller files are parsed on the calling thread
+	constexpr size_t MinChunkSize{ 1 << 16 };
+	// More chunks than threads, so a chunk full of faces does not leave the other threads waiting
+	constexpr uint32_t ChunksPerThread{ 4 };
+
+	enum CornerFlags : uint8_t
+	{
+		RelativePosition = 1 << 0,
+		RelativeNormal = 1 << 1,
+		HasNormal = 1 << 2
+	};
+
+	// A face corner as written in the file. Relative (negative) indices are counted from the vertices of their own chunk,
+	// they become absolute once the vertex counts of the earlier chunks are known.
+	struct Corner
+	{
+		int32_t position;
+		int32_t normal;
+		uint8_t flags;
+	};
+
+	struct Chunk
+	{
+		const char* pBegin{};
+		const char* pEnd{};
+
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		// Three corners per triangle
+		std::vector<Corner> corners{};
+		bool isValid{ true };
+
+		// Offsets of this chunk in the whole file
+		size_t firstPosition{};
+		size_t firstNormal{};
+		size_t firstTriangle{};
+	};
+
+#pragma region Number parsing
+	bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// Line ends are \n or \r\n, the \r is skipped as a blank
+	bool IsBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	bool IsSeparator(const char* p, const char* pEnd)
+	{
+		return p == pEnd || IsBlank(*p) || *p == '\n';
+	}
+
+	const char* SkipBlanks(const char* p, const char* pEnd)
+	{
+		while (p != pEnd && IsBlank(*p))
+			++p;
+		return p;
+	}
+
+	const char* SkipLine(const char* p, const char* pEnd)
+	{
+		const char* pNewline = static_cast<const char*>(std::memchr(p, '\n', pEnd - p));
+		return pNewline ? pNewline + 1 : pEnd;
+	}
+
+	bool ParseInt(const char*& p, const char* pEnd, int32_t& value)
+	{
+		const bool isNegative = p != pEnd && *p == '-';
+		if (p != pEnd && (*p == '-' || *p == '+'))
+			++p;
+
+		const char* pDigits = p;
+		int64_t result{};
+		while (p != pEnd && IsDigit(*p)) {
+			result = result * 10 + (*p - '0');
+			if (result > INT32_MAX)
+				return false;
+			++p;
+		}
+
+		value = static_cast<int32_t>(isNegative ? -result : result);
+		return p != pDigits;
+	}
+
+	// Decimal mantissas that fit a float exactly, scaled by a power of ten that does too, come out correctly rounded
+	// from a single multiplication or division. Everything else (long mantissas, large exponents, inf and nan) goes through from_chars,
+	// so the result always matches what the stream parser gave.
+	bool ParseFloat(const char*& p, const char* pEnd, float& value)
+	{
+		static constexpr float PowersOfTen[]{ 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+		constexpr uint64_t MaxExactMantissa{ 1 << 24 };
+		constexpr int MaxMantissaDigits{ 19 };
+
+		// from_chars does not take a plus sign
+		if (p != pEnd && *p == '+')
+			++p;
+		const char* pStart = p;
+
+		const bool isNegative = p != pEnd && *p == '-';
+		if (isNegative)
+			++p;
+
+		uint64_t mantissa{};
+		int nrDigits{};
+		int exponent{};
+		while (p != pEnd && IsDigit(*p)) {
+			mantissa = mantissa * 10 + (*p++ - '0');
+			++nrDigits;
+		}
+		if (p != pEnd && *p == '.') {
+			++p;
+			while (p != pEnd && IsDigit(*p)) {
+				mantissa = mantissa * 10 + (*p++ - '0');
+				++nrDigits;
+				--exponent;
+			}
+		}
+
+		const bool hasExponent = p != pEnd && (*p == 'e' || *p == 'E');
+		if (nrDigits > 0 && nrDigits <= MaxMantissaDigits && !hasExponent
+			&& mantissa <= MaxExactMantissa && -exponent < int(std::size(PowersOfTen))) {
+			const float result = static_cast<float>(mantissa) / PowersOfTen[-exponent];
+			value = isNegative ? -result : result;
+			return true;
+		}
+
+		const std::from_chars_result result = std::from_chars(pStart, pEnd, value);
+		p = result.ptr;
+		return result.ec == std::errc{};
+	}
+#pragma endregion
+
+	// OBJ indices start at 1, negative ones count back from the last vertex read so far
+	bool ReadIndex(const char*& p, const char* pEnd, size_t nrVertices, int32_t& index, uint8_t& flags, uint8_t relativeFlag)
+	{
+		int32_t value{};
+		if (!ParseInt(p, pEnd, value) || value == 0)
+			return false;
+
+		if (value > 0) {
+			index = value - 1;
+		}
+		else {
+			index = static_cast<int32_t>(nrVertices) + value;
+			flags |= relativeFlag;
+		}
+		return true;
+	}
+
+	// v, v/vt, v//vn or v/vt/vn
+	bool ReadCorner(const char*& p, const char* pEnd, const Chunk& chunk, Corner& corner)
+	{
+		corner.flags = 0;
+		if (!ReadIndex(p, pEnd, chunk.positions.size(), corner.position, corner.flags, RelativePosition))
+			return false;
+
+		if (p != pEnd && *p == '/') {
+			++p;
+			// Texture coordinate, not used
+			int32_t textureCoordinate{};
+			if (p != pEnd && *p != '/' && !ParseInt(p, pEnd, textureCoordinate))
+				return false;
+
+			if (p != pEnd && *p == '/') {
+				++p;
+				if (!ReadIndex(p, pEnd, chunk.normals.size(), corner.normal, corner.flags, RelativeNormal))
+					return false;
+				corner.flags |= HasNormal;
+			}
+		}
+
+		return IsSeparator(p, pEnd);
+	}
+
+	// Polygons are split in a fan around their first corner
+	bool ReadFace(const char*& p, const char* pEnd, Chunk& chunk)
+	{
+		Corner first{};
+		Corner previous{};
+		uint32_t nrCorners{};
+		while (true) {
+			p = SkipBlanks(p, pEnd);
+			if (p == pEnd || *p == '\n')
+				break;
+
+			Corner corner{};
+			if (!ReadCorner(p, pEnd, chunk, corner))
+				return false;
+
+			if (nrCorners == 0)
+				first = corner;
+			else if (nrCorners >= 2) {
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
+			}
+			previous = corner;
+			++nrCorners;
+		}
+		return nrCorners >= 3;
+	}
+
+	bool ReadVector(const char*& p, const char* pEnd, std::vector<Vector3>& vectors)
+	{
+		Vector3 vector{};
+		for (float* pComponent : { &vector.x, &vector.y, &vector.z }) {
+			p = SkipBlanks(p, pEnd);
+			if (!ParseFloat(p, pEnd, *pComponent) || !IsSeparator(p, pEnd))
+				return false;
+		}
+		vectors.push_back(vector);
+		return true;
+	}
+
+	void ParseChunk(Chunk& chunk)
+	{
+		const char* p = chunk.pBegin;
+		const char* pEnd = chunk.pEnd;
+		while (p != pEnd) {
+			p = SkipBlanks(p, pEnd);
+			if (p == pEnd)
+				break;
+
+			// Every other statement (comments, groups, materials, texture coordinates, ...) is skipped
+			const char next = p + 1 != pEnd ? p[1] : '\n';
+			bool isValid{ true };
+			if (*p == 'v' && IsBlank(next)) {
+				p += 1;
+				isValid = ReadVector(p, pEnd, chunk.positions);
+			}
+			else if (*p == 'v' && next == 'n' && IsSeparator(p + 2, pEnd)) {
+				p += 2;
+				isValid = ReadVector(p, pEnd, chunk.normals);
+			}
+			else if (*p == 'f' && IsBlank(next)) {
+				p += 1;
+				isValid = ReadFace(p, pEnd, chunk);
+			}
+
+			if (!isValid) {
+				chunk.isValid = false;
+				return;
+			}
+			p = SkipLine(p, pEnd);
+		}
+	}
+
+	// Turns the corners of a chunk into mesh indices and face normals, at the chunk's offset in the whole mesh
+	bool ResolveChunk(const Chunk& chunk, size_t nrPositions, size_t nrNormals,
+		const std::vector<Vector3>& positions, const std::vector<Vector3>& vertexNormals,
+		std::vector<int>& indices, std::vector<Vector3>& normals)
+	{
+		const auto resolve = [](const Corner& corner, int32_t index, uint8_t relativeFlag, size_t first, size_t count, int& result) {
+			const int64_t absolute = (corner.flags & relativeFlag) ? int64_t(first) + index : index;
+			result = static_cast<int>(absolute);
+			return absolute >= 0 && absolute < int64_t(count);
+		};
+
+		for (size_t triangle = 0; triangle < chunk.corners.size() / 3; triangle++) {
+			const Corner* pCorners = &chunk.corners[triangle * 3];
+			int* pIndices = &indices[(chunk.firstTriangle + triangle) * 3];
+
+			bool hasNormals{ true };
+			Vector3 vertexNormalSum{};
+			for (int corner = 0; corner < 3; corner++) {
+				if (!resolve(pCorners[corner], pCorners[corner].position, RelativePosition, chunk.firstPosition, nrPositions, pIndices[corner]))
+					return false;
+
+				if (!(pCorners[corner].flags & HasNormal)) {
+					hasNormals = false;
+					continue;
+				}
+				int normalIndex{};
+				if (!resolve(pCorners[corner], pCorners[corner].normal, RelativeNormal, chunk.firstNormal, nrNormals, normalIndex))
+					return false;
+				vertexNormalSum += vertexNormals[normalIndex];
+			}
+
+			// Without vertex normals this is the normal ParseOBJ gives, so meshes render the same through either parser
+			Vector3 normal{};
+			if (hasNormals && vertexNormalSum.SqrMagnitude() > 0.f)
+				normal = vertexNormalSum;
+			else
+				normal = Vector3::Cross(positions[pIndices[1]] - positions[pIndices[0]], positions[pIndices[2]] - positions[pIndices[0]]);
+			normal.Normalize();
+			normals[chunk.firstTriangle + triangle] = normal;
+		}
+		return true;
+	}
+}
+
+bool Utils::LoadOBJ(const std::string& filename, TriangleMesh& mesh, ThreadPool* pThreadPool)
+{
+	const MappedFile file{ filename };
+	if (!file.IsOpen())
+		return false;
+
+	const char* pData = file.GetData();
+	const size_t size = file.GetSize();
+
+	// A temporary pool only pays off when there is more than one chunk
+	std::unique_ptr<ThreadPool> pLocalThreadPool{};
+	uint32_t nrChunks = static_cast<uint32_t>(std::max<size_t>(size / MinChunkSize, 1));
+	if (nrChunks > 1 && !pThreadPool) {
+		pLocalThreadPool = std::make_unique<ThreadPool>();
+		pThreadPool = pLocalThreadPool.get();
+	}
+	nrChunks = std::min(nrChunks, pThreadPool ? pThreadPool->GetNrThreads() * ChunksPerThread : 1);
+
+	const auto parallelFor = [pThreadPool](uint32_t nrTasks, const std::function<void(uint32_t)>& job) {
+		if (nrTasks > 1)
+			pThreadPool->ParallelFor(nrTasks, job);
+		else if (nrTasks == 1)
+			job(0);
+	};
+
+	// Chunk boundaries move forward to the next line start, a chunk can end up empty on a file with very long lines
+	std::vector<Chunk> chunks(nrChunks);
+	for (uint32_t index = 0; index < nrChunks; index++) {
+		chunks[index].pBegin = index == 0 ? pData : chunks[index - 1].pEnd;
+		chunks[index].pEnd = index + 1 == nrChunks ? pData + size
+			: std::max(chunks[index].pBegin, SkipLine(pData + size * (index + 1) / nrChunks, pData + size));
+	}
+
+	parallelFor(nrChunks, [&chunks](uint32_t index) { ParseChunk(chunks[index]); });
+
+	size_t nrPositions{};
+	size_t nrNormals{};
+	size_t nrTriangles{};
+	for (Chunk& chunk : chunks) {
+		if (!chunk.isValid)
+			return false;
+
+		chunk.firstPosition = nrPositions;
+		chunk.firstNormal = nrNormals;
+		chunk.firstTriangle = nrTriangles;
+		nrPositions += chunk.positions.size();
+		nrNormals += chunk.normals.size();
+		nrTriangles += chunk.corners.size() / 3;
+	}
+	if (nrPositions > size_t(INT32_MAX))
+		return false;
+
+	std::vector<Vector3> positions(nrPositions);
+	std::vector<Vector3> vertexNormals(nrNormals);
+	parallelFor(nrChunks, [&](uint32_t index) {
+		const Chunk& chunk = chunks[index];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.firstPosition);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), vertexNormals.begin() + chunk.firstNormal);
+		});
+
+	std::vector<int> indices(nrTriangles * 3);
+	std::vector<Vector3> normals(nrTriangles);
+	std::vector<uint8_t> isResolved(nrChunks);
+	parallelFor(nrChunks, [&](uint32_t index) {
+		isResolved[index] = ResolveChunk(chunks[index], nrPositions, nrNormals, positions, vertexNormals, indices, normals);
+		});
+	if (std::find(isResolved.begin(), isResolved.end(), uint8_t(0)) != isResolved.end())
+		return false;
+
+	mesh.positions = std::move(positions);
+	mesh.indices = std::move(indices);
+	mesh.normals = std::move(normals);
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	struct TriangleMesh;
+	class ThreadPool;
+
+	namespace Utils
+	{
+		// Loads the faces of an OBJ file into the positions, indices and face normals of the mesh, replacing what it held.
+		// The file is memory-mapped and split into line-aligned chunks that are parsed in parallel on the thread pool,
+		// a temporary pool is created when none is passed.
+		//
+		// Faces take any of the v, v/vt, v//vn and v/vt/vn forms with positive or negative (relative) indices,
+		// polygons are fan-triangulated. Texture coordinates are skipped, the ray tracer has no use for them.
+		// A face whose corners all reference vertex normals gets their average as its normal, other faces get the normal of their winding.
+		// Returns false when the file cannot be read, a line is malformed or an index is out of range; the mesh is then left untouched.
+		bool LoadOBJ(const std::string& filename, TriangleMesh& mesh, ThreadPool* pThreadPool = nullptr);
+	}
+}
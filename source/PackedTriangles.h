@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "BVH.h"
+#include "SIMD.h"
+
+namespace dae
+{
+	// Structure of arrays with everything the mesh intersection needs per triangle, precomputed once per transform update.
+	// Triangles are stored in BVH leaf order: slot i holds triangle bvh.primitiveIndices[i], so every leaf is one contiguous range.
+	// The arrays are padded with SIMD::FloatN::Width - 1 zeroed slots, so a full register can be loaded from any slot.
+	struct PackedTriangles
+	{
+		uint32_t triangleCount{};
+
+		std::vector<float> v0X{}, v0Y{}, v0Z{};
+		// v1 - v0 and v2 - v0
+		std::vector<float> edge1X{}, edge1Y{}, edge1Z{};
+		std::vector<float> edge2X{}, edge2Y{}, edge2Z{};
+		// Cross(edge1, edge2), the determinant terms of Moller-Trumbore
+		std::vector<float> crossX{}, crossY{}, crossZ{};
+		// Normalized triangle normal, used for culling and the hit record
+		std::vector<float> normalX{}, normalY{}, normalZ{};
+
+		Vector3 GetV0(uint32_t slot) const { return { v0X[slot], v0Y[slot], v0Z[slot] }; }
+		Vector3 GetEdge1(uint32_t slot) const { return { edge1X[slot], edge1Y[slot], edge1Z[slot] }; }
+		Vector3 GetEdge2(uint32_t slot) const { return { edge2X[slot], edge2Y[slot], edge2Z[slot] }; }
+		Vector3 GetCross(uint32_t slot) const { return { crossX[slot], crossY[slot], crossZ[slot] }; }
+		Vector3 GetNormal(uint32_t slot) const { return { normalX[slot], normalY[slot], normalZ[slot] }; }
+
+		void Build(const std::vector<Vector3>& positions, const std::vector<int>& indices, const std::vector<Vector3>& normals, const BVH& bvh)
+		{
+			const size_t nrTriangles = bvh.GetPrimitiveCount();
+			const uint32_t* pPrimitiveIndices = bvh.GetPrimitiveIndices();
+			triangleCount = static_cast<uint32_t>(nrTriangles);
+			for (std::vector<float>* pComponent : { &v0X, &v0Y, &v0Z, &edge1X, &edge1Y, &edge1Z, &edge2X, &edge2Y, &edge2Z,
+				&crossX, &crossY, &crossZ, &normalX, &normalY, &normalZ })
+				pComponent->resize(nrTriangles + SIMD::FloatN::Width - 1);
+
+			for (size_t slot = 0; slot < nrTriangles; slot++) {
+				const uint32_t triangleIndex = pPrimitiveIndices[slot];
+				const Vector3& v0 = positions[indices[triangleIndex * 3]];
+				const Vector3 edge1 = positions[indices[triangleIndex * 3 + 1]] - v0;
+				const Vector3 edge2 = positions[indices[triangleIndex * 3 + 2]] - v0;
+				const Vector3 cross = Vector3::Cross(edge1, edge2);
+				const Vector3 normal = normals[triangleIndex].Normalized();
+
+				v0X[slot] = v0.x; v0Y[slot] = v0.y; v0Z[slot] = v0.z;
+				edge1X[slot] = edge1.x; edge1Y[slot] = edge1.y; edge1Z[slot] = edge1.z;
+				edge2X[slot] = edge2.x; edge2Y[slot] = edge2.y; edge2Z[slot] = edge2.z;
+				crossX[slot] = cross.x; crossY[slot] = cross.y; crossZ[slot] = cross.z;
+				normalX[slot] = normal.x; normalY[slot] = normal.y; normalZ[slot] = normal.z;
+			}
+		}
+	};
+}
@@ -1,10 +1,12 @@
 #define PARALLEL_EXECUTION
 
 //External includes
+#if !defined(HEADLESS)
 #include "SDL.h"
 #include "SDL_surface.h"
+#endif
+#include <algorithm>
 #include <iostream>
-#include <execution>
 
 //Project includes
 #include "Renderer.h"
@@ -16,6 +18,21 @@
 
 using namespace dae;
 
+namespace
+{
+	// Van der Corput radical inverse of index in the given base, in [0, 1)
+	float RadicalInverse(uint32_t index, uint32_t base)
+	{
+		float result{}, digitWeight{ 1.f / base };
+		for (; index > 0; index /= base) {
+			result += (index % base) * digitWeight;
+			digitWeight /= base;
+		}
+		return result;
+	}
+}
+
+#if !defined(HEADLESS)
 Renderer::Renderer(SDL_Window * pWindow) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
@@ -23,103 +40,541 @@ Renderer::Renderer(SDL_Window * pWindow) :
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_pRenderPixels = m_pBufferPixels;
+	m_RenderWidth = m_Width;
+	m_RenderHeight = m_Height;
+
+	InitializeTiles();
+}
+#endif
+
+Renderer::Renderer(uint32_t width, uint32_t height) :
+	m_OffscreenPixels(size_t(width) * height),
+	m_Width(int(width)),
+	m_Height(int(height)),
+	m_RenderWidth(int(width)),
+	m_RenderHeight(int(height))
+{
+	m_pBufferPixels = m_OffscreenPixels.data();
+	m_pRenderPixels = m_pBufferPixels;
+
+	InitializeTiles();
+}
+
+void Renderer::SetRenderScale(float scale)
+{
+	const int renderWidth{ std::clamp(static_cast<int>(m_Width * scale + 0.5f), 1, m_Width) };
+	const int renderHeight{ std::clamp(static_cast<int>(m_Height * scale + 0.5f), 1, m_Height) };
+	if (renderWidth == m_RenderWidth && renderHeight == m_RenderHeight)
+		return;
+
+	m_RenderWidth = renderWidth;
+	m_RenderHeight = renderHeight;
+
+	// At full resolution the frame goes straight to the output buffer
+	if (m_RenderWidth == m_Width && m_RenderHeight == m_Height) {
+		m_pRenderPixels = m_pBufferPixels;
+	}
+	else {
+		m_ScaledPixels.resize(size_t(m_RenderWidth) * m_RenderHeight);
+		m_pRenderPixels = m_ScaledPixels.data();
+	}
+
+	InitializeTiles();
+	ResetAccumulation();
+	// The G-buffer has the new size, but none of its pixels are traced yet
+	m_IsGBufferComplete = false;
+}
+
+void Renderer::InitializeTiles()
+{
+	m_NrTilesX = (m_RenderWidth + TileSize - 1) / TileSize;
+	m_NrTilesY = (m_RenderHeight + TileSize - 1) / TileSize;
+
+	m_GBuffer.Resize(size_t(m_RenderWidth) * m_RenderHeight);
+	m_PixelColors.resize(size_t(m_RenderWidth) * m_RenderHeight);
+	m_PixelContrast.resize(size_t(m_RenderWidth) * m_RenderHeight);
+	// Room for every pixel, so a frame with more edges than the ones before it does not allocate
+	m_AdaptivePixels.reserve(size_t(m_RenderWidth) * m_RenderHeight);
+}
+
+void Renderer::Render(Scene* pScene)
+{
+	if (m_UseProgressive) {
+		// Converged, the buffer already holds the image
+		if (m_NrAccumulatedFrames == MaxAccumulatedFrames)
+			return;
+
+		if (m_NrAccumulatedFrames == 0)
+			m_Accumulation.assign(size_t(m_RenderWidth) * m_RenderHeight, ColorRGB{});
+
+		// The first sample goes through the pixel centre like a regular frame, the next ones follow a Halton (2, 3) sequence
+		m_FrameSampleX = m_NrAccumulatedFrames == 0 ? 0.5f : RadicalInverse(m_NrAccumulatedFrames, 2);
+		m_FrameSampleY = m_NrAccumulatedFrames == 0 ? 0.5f : RadicalInverse(m_NrAccumulatedFrames, 3);
+		++m_NrAccumulatedFrames;
+	}
+	else {
+		m_FrameSampleX = 0.5f;
+		m_FrameSampleY = 0.5f;
+	}
+
+	BeginFrame(pScene);
+	const Camera& camera = pScene->GetCamera();
+
+	const uint32_t amountOfTiles{ m_NrTilesX * m_NrTilesY };
+
+#if defined (PARALLEL_EXECUTION)
+	// Each tile can be traced in parallel
+	m_ThreadPool.ParallelFor(amountOfTiles, [&](uint32_t tileIndex) {
+		TraceTile(pScene, tileIndex, camera.origin);
+		});
+
+#else
+	// If no threads
+	for (uint32_t tileIndex{}; tileIndex < amountOfTiles; tileIndex++) {
+		TraceTile(pScene, tileIndex, camera.origin);
+	}
+
+#endif
+	m_IsGBufferComplete = true;
+	ShadeGBuffer(pScene);
 }
 
-void Renderer::Render(Scene* pScene) const
+bool Renderer::RenderRefining(Scene* pScene, const std::function<bool()>& isCancelled)
 {
+	m_FrameSampleX = 0.5f;
+	m_FrameSampleY = 0.5f;
+	BeginFrame(pScene);
+	const Vector3 cameraOrigin{ pScene->GetCamera().origin };
+	m_IsGBufferComplete = false;
+
+	// Cancellation is checked before every row of tiles, the workers never wait for the caller
+	for (uint32_t blockSize{ MaxRefinementBlockSize }; blockSize > 0; blockSize /= 2) {
+		for (uint32_t tileY{}; tileY < m_NrTilesY; ++tileY) {
+			if (isCancelled && isCancelled())
+				return false;
+
+#if defined (PARALLEL_EXECUTION)
+			m_ThreadPool.ParallelFor(m_NrTilesX, [&](uint32_t tileX) {
+				RefineTile(pScene, tileX + tileY * m_NrTilesX, blockSize, cameraOrigin);
+				});
+#else
+			for (uint32_t tileX{}; tileX < m_NrTilesX; ++tileX) {
+				RefineTile(pScene, tileX + tileY * m_NrTilesX, blockSize, cameraOrigin);
+			}
+#endif
+		}
+		Present();
+	}
+	// Every pixel was traced by exactly one level, so the G-buffer holds the whole frame
+	m_IsGBufferComplete = true;
+	return true;
+}
+
+void Renderer::BeginFrame(Scene* pScene)
+{
+	pScene->UpdateAccelerationStructure();
+
 	Camera& camera = pScene->GetCamera();
-	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+	m_FrameCameraToWorld = camera.CalculateCameraToWorld();
 
-	const float aspectRatio = m_Width / static_cast<float>(m_Height);
+	m_FrameAspectRatio = m_Width / static_cast<float>(m_Height);
 	const float fovAngle = camera.fovAngle * TO_RADIANS;
-	const float fov = tan(fovAngle / 2.f);
+	m_FrameFov = tan(fovAngle / 2.f);
+}
+
+void Renderer::Shade(Scene* pScene)
+{
+	if (!m_IsGBufferComplete)
+		return;
+
+	// The sample in the G-buffer is already part of the accumulation, adding it again would outweigh the others
+	ResetAccumulation();
+	ShadeGBuffer(pScene);
+}
+
+void Renderer::ShadeGBuffer(Scene* pScene)
+{
+	// Pixels of the same material are shaded together, they run the same code and read the same material
+	m_GBuffer.SortByMaterial(pScene->GetMaterials().size());
+	const uint32_t amountOfChunks{ (m_GBuffer.GetNrHits() + ShadingChunkSize - 1) / ShadingChunkSize };
 
 #if defined (PARALLEL_EXECUTION)
-	//Parallel stuff
-	uint32_t amountOfPixels{ uint32_t(m_Width * m_Height)};
-	std::vector<uint32_t> pixelIndices{};
-
-	// Reserve a colour buffer
-	pixelIndices.reserve(amountOfPixels);
-	for (uint32_t index{}; index < amountOfPixels; ++index)
-		pixelIndices.emplace_back(index);
-
-	// Each pixel can de rendered in parallel
-	std::for_each(std::execution::par, pixelIndices.begin(), pixelIndices.end(), [&](int i) {
-		RenderPixel(pScene, i, fov, aspectRatio, cameraToWorld, camera.origin);
+	m_ThreadPool.ParallelFor(amountOfChunks, [&](uint32_t chunkIndex) {
+		ShadeChunk(pScene, chunkIndex);
 		});
 
 #else
-	// If no threads
-	uint32_t amountOfPixels{ uint32_t(m_Width * m_Height) };
-	for (uint32_t pixelIndex{}; pixelIndex < amountOfPixels; pixelIndex++) {
-		RenderPixel(pScene, pixelIndex, fov, aspectRatio, cameraToWorld, camera.origin);
+	for (uint32_t chunkIndex{}; chunkIndex < amountOfChunks; chunkIndex++) {
+		ShadeChunk(pScene, chunkIndex);
 	}
 
 #endif
+	// A progressive image gets its anti-aliasing from the accumulated samples
+	if (m_UseAdaptiveSampling && m_NrAccumulatedFrames == 0)
+		SampleAdaptively(pScene);
+
+	Present();
+}
+
+void Renderer::Present()
+{
+	if (m_pRenderPixels != m_pBufferPixels)
+		Upscale();
+
 	//@END
+#if !defined(HEADLESS)
 	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	if (m_pWindow)
+		SDL_UpdateWindowSurface(m_pWindow);
+#endif
+}
+
+void dae::Renderer::TraceTile(Scene* pScene, uint32_t tileIndex, const Vector3& cameraOrigin)
+{
+	// Tiles on the right and bottom edge can be cut off by the screen
+	const uint32_t startX{ (tileIndex % m_NrTilesX) * TileSize }, startY{ (tileIndex / m_NrTilesX) * TileSize };
+	const uint32_t endX{ std::min(startX + TileSize, uint32_t(m_RenderWidth)) }, endY{ std::min(startY + TileSize, uint32_t(m_RenderHeight)) };
+
+	if (m_UsePacketTracing) {
+		for (uint32_t py{ startY }; py < endY; py += RayPacket::Height) {
+			for (uint32_t px{ startX }; px < endX; px += RayPacket::Width) {
+				TracePacket(pScene, px, py, endX, endY, cameraOrigin);
+			}
+		}
+	}
+	else {
+		for (uint32_t py{ startY }; py < endY; ++py) {
+			for (uint32_t px{ startX }; px < endX; ++px) {
+				const Ray hitRay = Ray(cameraOrigin, CalculateRayDirection(px, py, m_FrameFov, m_FrameAspectRatio, m_FrameCameraToWorld, m_FrameSampleX, m_FrameSampleY));
+				HitRecord closestHit{};
+				pScene->GetClosestHit(hitRay, closestHit);
+				m_GBuffer.Write(px + py * m_RenderWidth, closestHit);
+			}
+		}
+	}
+
+	// Nothing to shade where the primary ray missed, those pixels are written here
+	for (uint32_t py{ startY }; py < endY; ++py) {
+		for (uint32_t px{ startX }; px < endX; ++px) {
+			if (m_GBuffer.materialIds[px + py * m_RenderWidth] == GBuffer::NoHit)
+				WritePixel(px + py * m_RenderWidth, ColorRGB{});
+		}
+	}
+}
+
+void dae::Renderer::RefineTile(Scene* pScene, uint32_t tileIndex, uint32_t blockSize, const Vector3& cameraOrigin)
+{
+	const uint32_t startX{ (tileIndex % m_NrTilesX) * TileSize }, startY{ (tileIndex / m_NrTilesX) * TileSize };
+	const uint32_t endX{ std::min(startX + TileSize, uint32_t(m_RenderWidth)) }, endY{ std::min(startY + TileSize, uint32_t(m_RenderHeight)) };
+
+	ShadowCache shadowCache{};
+	for (uint32_t py{ startY }; py < endY; py += blockSize) {
+		for (uint32_t px{ startX }; px < endX; px += blockSize) {
+			// Corners of the blocks twice as large were traced by the previous level
+			if (blockSize < MaxRefinementBlockSize && px % (blockSize * 2) == 0 && py % (blockSize * 2) == 0)
+				continue;
+
+			const Ray hitRay = Ray(cameraOrigin, CalculateRayDirection(px, py, m_FrameFov, m_FrameAspectRatio, m_FrameCameraToWorld));
+			HitRecord closestHit{};
+			pScene->GetClosestHit(hitRay, closestHit);
+			m_GBuffer.Write(px + py * m_RenderWidth, closestHit);
+			const uint32_t color{ MapColor(ShadePixel(pScene, closestHit, hitRay.direction, &shadowCache)) };
+
+			// The traced pixel stands in for its whole block until a finer level replaces the others
+			const uint32_t blockEndX{ std::min(px + blockSize, endX) }, blockEndY{ std::min(py + blockSize, endY) };
+			for (uint32_t y{ py }; y < blockEndY; ++y) {
+				for (uint32_t x{ px }; x < blockEndX; ++x)
+					m_pRenderPixels[x + y * m_RenderWidth] = color;
+			}
+		}
+	}
+
+	m_NrShadowRays += shadowCache.nrShadowRays;
+	m_NrOccludedShadowRays += shadowCache.nrOccluded;
+	m_NrShadowCacheHits += shadowCache.nrHits;
 }
 
-void dae::Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin) const
+void dae::Renderer::TracePacket(Scene* pScene, uint32_t px, uint32_t py, uint32_t endX, uint32_t endY, const Vector3& cameraOrigin)
 {
-	auto materials{ pScene->GetMaterials()};
-	const uint32_t px{ pixelIndex % m_Width }, py{ pixelIndex / m_Width };
+	RayPacket packet{};
+	packet.origin = cameraOrigin;
 
+	// Lanes are filled row by row
+	for (uint32_t lane{}; lane < RayPacket::Size; ++lane) {
+		const uint32_t x{ px + lane % RayPacket::Width }, y{ py + lane / RayPacket::Width };
+		if (x >= endX || y >= endY)
+			continue;
+
+		const Vector3 rayDirection = CalculateRayDirection(x, y, m_FrameFov, m_FrameAspectRatio, m_FrameCameraToWorld, m_FrameSampleX, m_FrameSampleY);
+		packet.directionX[lane] = rayDirection.x;
+		packet.directionY[lane] = rayDirection.y;
+		packet.directionZ[lane] = rayDirection.z;
+		packet.laneMask |= 1u << lane;
+	}
+
+	HitRecord closestHits[RayPacket::Size]{};
+	pScene->GetClosestHits(packet, closestHits);
+
+	for (uint32_t lane{}; lane < RayPacket::Size; ++lane) {
+		if (packet.laneMask & (1u << lane))
+			m_GBuffer.Write(px + lane % RayPacket::Width + (py + lane / RayPacket::Width) * m_RenderWidth, closestHits[lane]);
+	}
+}
+
+void dae::Renderer::ShadeChunk(Scene* pScene, uint32_t chunkIndex)
+{
+	const uint32_t first{ chunkIndex * ShadingChunkSize };
+	const uint32_t last{ std::min(first + ShadingChunkSize, m_GBuffer.GetNrHits()) };
+
+	ShadowCache shadowCache{};
+	for (uint32_t i{ first }; i < last; ++i) {
+		const uint32_t pixelIndex{ m_GBuffer.shadingOrder[i] };
+		const uint32_t px{ pixelIndex % m_RenderWidth }, py{ pixelIndex / m_RenderWidth };
+
+		HitRecord closestHit{ m_GBuffer.Read(pixelIndex) };
+		const Vector3 viewDir{ CalculateRayDirection(px, py, m_FrameFov, m_FrameAspectRatio, m_FrameCameraToWorld, m_FrameSampleX, m_FrameSampleY) };
+		WritePixel(pixelIndex, ShadePixel(pScene, closestHit, viewDir, &shadowCache));
+	}
+
+	m_NrShadowRays += shadowCache.nrShadowRays;
+	m_NrOccludedShadowRays += shadowCache.nrOccluded;
+	m_NrShadowCacheHits += shadowCache.nrHits;
+}
+
+Vector3 Renderer::CalculateRayDirection(uint32_t px, uint32_t py, float fov, float aspectRatio, const Matrix& cameraToWorld, float sampleX, float sampleY) const
+{
 	// Find the pixel in camera space
-	float rx{ px + 0.5f }, ry{ py + 0.5f };
-	float cx{ (2 * (rx / float(m_Width)) - 1) * aspectRatio * fov };
-	float cy{ (1 - (2 * (ry / float(m_Height)))) * fov };
+	float rx{ px + sampleX }, ry{ py + sampleY };
+	float cx{ (2 * (rx / float(m_RenderWidth)) - 1) * aspectRatio * fov };
+	float cy{ (1 - (2 * (ry / float(m_RenderHeight)))) * fov };
 
-	// Create a ray for the pixel
-	Vector3 rayDirection = cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized();
-	Ray hitRay = Ray(cameraOrigin, rayDirection);
+	return cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized();
+}
 
+ColorRGB Renderer::ShadePixel(Scene* pScene, HitRecord& closestHit, const Vector3& viewDir, ShadowCache* pShadowCache) const
+{
 	// Set up Color to write to buffer
 	ColorRGB finalColor{};
 
-	// HitRecord containing information about a potential hit
-	HitRecord closestHit{};
-	pScene->GetClosestHit(hitRay, closestHit);
-
 	if (closestHit.didHit) {
-		finalColor = m_colorManager.CalculateColor(pScene, &closestHit, hitRay.direction);
+		finalColor = m_colorManager.CalculateColor(pScene, &closestHit, viewDir, pShadowCache);
 	}
 
-	//Update Color in Buffer
 	finalColor.MaxToOne();
+	return finalColor;
+}
+
+void Renderer::WritePixel(uint32_t pixelIndex, const ColorRGB& color)
+{
+	if (m_NrAccumulatedFrames == 0) {
+		m_PixelColors[pixelIndex] = color;
+		m_pRenderPixels[pixelIndex] = MapColor(color);
+		return;
+	}
+
+	// The pixel shows the mean of its samples so far
+	ColorRGB& accumulated{ m_Accumulation[pixelIndex] };
+	accumulated += color;
+	m_pRenderPixels[pixelIndex] = MapColor(accumulated * (1.f / m_NrAccumulatedFrames));
+}
+
+void Renderer::SampleAdaptively(Scene* pScene)
+{
+	const uint32_t nrPixels{ uint32_t(m_RenderWidth) * m_RenderHeight };
+
+#if defined (PARALLEL_EXECUTION)
+	m_ThreadPool.ParallelFor(uint32_t(m_RenderHeight), [&](uint32_t py) {
+		for (uint32_t px{}; px < uint32_t(m_RenderWidth); ++px)
+			m_PixelContrast[px + py * m_RenderWidth] = CalculateContrast(px, py);
+		});
+#else
+	for (uint32_t py{}; py < uint32_t(m_RenderHeight); ++py) {
+		for (uint32_t px{}; px < uint32_t(m_RenderWidth); ++px)
+			m_PixelContrast[px + py * m_RenderWidth] = CalculateContrast(px, py);
+	}
+#endif
+
+	m_AdaptivePixels.clear();
+	for (uint32_t pixelIndex{}; pixelIndex < nrPixels; ++pixelIndex) {
+		if (m_PixelContrast[pixelIndex] > AdaptiveContrastThreshold)
+			m_AdaptivePixels.push_back(pixelIndex);
+	}
+
+	// Over budget, only the pixels with the highest contrast get their extra samples
+	const uint32_t maxPixels{ static_cast<uint32_t>(m_AdaptiveRayBudget * nrPixels) / AdaptiveSamplesPerPixel };
+	if (m_AdaptivePixels.size() > maxPixels) {
+		std::nth_element(m_AdaptivePixels.begin(), m_AdaptivePixels.begin() + maxPixels, m_AdaptivePixels.end(),
+			[this](uint32_t a, uint32_t b) { return m_PixelContrast[a] > m_PixelContrast[b]; });
+		m_AdaptivePixels.resize(maxPixels);
+	}
+
+	const uint32_t amountOfChunks{ (static_cast<uint32_t>(m_AdaptivePixels.size()) + ShadingChunkSize - 1) / ShadingChunkSize };
+
+#if defined (PARALLEL_EXECUTION)
+	m_ThreadPool.ParallelFor(amountOfChunks, [&](uint32_t chunkIndex) {
+		SampleAdaptiveChunk(pScene, chunkIndex);
+		});
+#else
+	for (uint32_t chunkIndex{}; chunkIndex < amountOfChunks; chunkIndex++) {
+		SampleAdaptiveChunk(pScene, chunkIndex);
+	}
+#endif
+}
+
+float Renderer::CalculateContrast(uint32_t px, uint32_t py) const
+{
+	// Luminance range over the pixel and its four neighbours, an edge between two materials counts as full contrast
+	const uint32_t pixelIndex{ px + py * m_RenderWidth };
+	const auto luminance = [this](uint32_t index) {
+		const ColorRGB& color{ m_PixelColors[index] };
+		return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+	};
+
+	float minLuminance{ luminance(pixelIndex) }, maxLuminance{ minLuminance };
+	const auto addNeighbour = [&](uint32_t neighbourIndex) {
+		if (m_GBuffer.materialIds[neighbourIndex] != m_GBuffer.materialIds[pixelIndex])
+			maxLuminance = FLT_MAX;
+		const float neighbourLuminance{ luminance(neighbourIndex) };
+		minLuminance = std::min(minLuminance, neighbourLuminance);
+		maxLuminance = std::max(maxLuminance, neighbourLuminance);
+	};
+
+	if (px > 0)									addNeighbour(pixelIndex - 1);
+	if (px + 1 < uint32_t(m_RenderWidth))		addNeighbour(pixelIndex + 1);
+	if (py > 0)									addNeighbour(pixelIndex - m_RenderWidth);
+	if (py + 1 < uint32_t(m_RenderHeight))		addNeighbour(pixelIndex + m_RenderWidth);
+
+	return maxLuminance - minLuminance;
+}
+
+void Renderer::SampleAdaptiveChunk(Scene* pScene, uint32_t chunkIndex)
+{
+	// Stratified over the quadrants of the pixel, the centre sample of the frame is the fifth
+	constexpr float sampleOffsets[AdaptiveSamplesPerPixel][2]{ { 0.25f, 0.25f }, { 0.75f, 0.25f }, { 0.25f, 0.75f }, { 0.75f, 0.75f } };
+
+	const uint32_t first{ chunkIndex * ShadingChunkSize };
+	const uint32_t last{ std::min(first + ShadingChunkSize, static_cast<uint32_t>(m_AdaptivePixels.size())) };
+	const Vector3 cameraOrigin{ m_FrameCameraToWorld.GetTranslation() };
+
+	ShadowCache shadowCache{};
+	for (uint32_t i{ first }; i < last; ++i) {
+		const uint32_t pixelIndex{ m_AdaptivePixels[i] };
+		const uint32_t px{ pixelIndex % m_RenderWidth }, py{ pixelIndex / m_RenderWidth };
+
+		ColorRGB color{ m_PixelColors[pixelIndex] };
+		for (const auto& offset : sampleOffsets) {
+			const Ray hitRay = Ray(cameraOrigin, CalculateRayDirection(px, py, m_FrameFov, m_FrameAspectRatio, m_FrameCameraToWorld, offset[0], offset[1]));
+			HitRecord closestHit{};
+			pScene->GetClosestHit(hitRay, closestHit);
+			color += ShadePixel(pScene, closestHit, hitRay.direction, &shadowCache);
+		}
+
+		m_pRenderPixels[pixelIndex] = MapColor(color * (1.f / (AdaptiveSamplesPerPixel + 1)));
+	}
+
+	m_NrShadowRays += shadowCache.nrShadowRays;
+	m_NrOccludedShadowRays += shadowCache.nrOccluded;
+	m_NrShadowCacheHits += shadowCache.nrHits;
+}
+
+void Renderer::Upscale()
+{
+	// Bilinear filter, pixel centres of the output are mapped onto the render target
+	const float scaleX{ m_RenderWidth / static_cast<float>(m_Width) }, scaleY{ m_RenderHeight / static_cast<float>(m_Height) };
+	const auto upscaleRow = [&](uint32_t py) {
+		const float sy{ std::clamp((py + 0.5f) * scaleY - 0.5f, 0.f, float(m_RenderHeight - 1)) };
+		const uint32_t y0{ static_cast<uint32_t>(sy) }, y1{ std::min(y0 + 1, uint32_t(m_RenderHeight - 1)) };
+		const float fy{ sy - y0 };
+
+		for (uint32_t px{}; px < uint32_t(m_Width); ++px) {
+			const float sx{ std::clamp((px + 0.5f) * scaleX - 0.5f, 0.f, float(m_RenderWidth - 1)) };
+			const uint32_t x0{ static_cast<uint32_t>(sx) }, x1{ std::min(x0 + 1, uint32_t(m_RenderWidth - 1)) };
+			const float fx{ sx - x0 };
+
+			uint8_t corners[4][3]{};
+			UnmapColor(m_pRenderPixels[x0 + y0 * m_RenderWidth], corners[0]);
+			UnmapColor(m_pRenderPixels[x1 + y0 * m_RenderWidth], corners[1]);
+			UnmapColor(m_pRenderPixels[x0 + y1 * m_RenderWidth], corners[2]);
+			UnmapColor(m_pRenderPixels[x1 + y1 * m_RenderWidth], corners[3]);
+
+			uint8_t channels[3]{};
+			for (int channel{}; channel < 3; ++channel) {
+				const float top{ corners[0][channel] + (corners[1][channel] - corners[0][channel]) * fx };
+				const float bottom{ corners[2][channel] + (corners[3][channel] - corners[2][channel]) * fx };
+				channels[channel] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+			}
+			m_pBufferPixels[px + py * m_Width] = MapColor(channels[0], channels[1], channels[2]);
+		}
+	};
+
+#if defined (PARALLEL_EXECUTION)
+	m_ThreadPool.ParallelFor(uint32_t(m_Height), upscaleRow);
+#else
+	for (uint32_t py{}; py < uint32_t(m_Height); ++py)
+		upscaleRow(py);
+#endif
+}
+
+uint32_t Renderer::MapColor(const ColorRGB& color) const
+{
+	const uint8_t r{ static_cast<uint8_t>(color.r * 255) };
+	const uint8_t g{ static_cast<uint8_t>(color.g * 255) };
+	const uint8_t b{ static_cast<uint8_t>(color.b * 255) };
+	return MapColor(r, g, b);
+}
+
+uint32_t Renderer::MapColor(uint8_t r, uint8_t g, uint8_t b) const
+{
+#if !defined(HEADLESS)
+	if (m_pBuffer)
+		return SDL_MapRGB(m_pBuffer->format, r, g, b);
+#endif
+	//Offscreen buffers are always stored as 0xAARRGGBB
+	return 0xFF000000 | (uint32_t(r) << 16) | (uint32_t(g) << 8) | uint32_t(b);
+}
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+void Renderer::UnmapColor(uint32_t pixel, uint8_t rgb[3]) const
+{
+#if !defined(HEADLESS)
+	if (m_pBuffer) {
+		SDL_GetRGB(pixel, m_pBuffer->format, &rgb[0], &rgb[1], &rgb[2]);
+		return;
+	}
+#endif
+	rgb[0] = static_cast<uint8_t>(pixel >> 16);
+	rgb[1] = static_cast<uint8_t>(pixel >> 8);
+	rgb[2] = static_cast<uint8_t>(pixel);
 }
 
-bool Renderer::SaveBufferToImage() const
+bool Renderer::SaveBufferToImage(const std::string& filename) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+#if !defined(HEADLESS)
+	if (m_pBuffer)
+		return SDL_SaveBMP(m_pBuffer, filename.c_str());
+#endif
+	return !Utils::WriteBMP(filename, m_pBufferPixels, m_Width, m_Height);
 }
 
-ColorRGB ColorManager::CalculateColor(Scene* pScene, HitRecord* hit, const Vector3& viewDir) const
+ColorRGB ColorManager::CalculateColor(Scene* pScene, HitRecord* hit, const Vector3& viewDir, ShadowCache* pShadowCache) const
 {
 	ColorRGB color{};
 
 	switch (this->m_currentLightingMode) {
 	case(LightingMode::Radiance):
-		color = pScene->GetRadiance(hit, m_ShadowsEnabled);
+		color = pScene->GetRadiance(hit, m_ShadowsEnabled, pShadowCache);
 		break;
 
 	case (LightingMode::ObservedArea):
-		color = pScene->GetObservedArea(hit, m_ShadowsEnabled);
+		color = pScene->GetObservedArea(hit, m_ShadowsEnabled, pShadowCache);
 		break;
 
 	case (LightingMode::Combined):
-		color = pScene->GetColour(hit, m_ShadowsEnabled, viewDir);
+		color = pScene->GetColour(hit, m_ShadowsEnabled, viewDir, pShadowCache);
 		break;
 
 	case (LightingMode::BRDF):
-		color = pScene->GetBRDF(hit, m_ShadowsEnabled, viewDir);
+		color = pScene->GetBRDF(hit, m_ShadowsEnabled, viewDir, pShadowCache);
 		break;
 	}
 	color.MaxToOne();
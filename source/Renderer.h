@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
 #include "Vector3.h"
 #include "Camera.h"
 #include <iostream>
 
 #include "Utils.h"
+#include "GBuffer.h"
+#include "ThreadPool.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -13,6 +19,7 @@ struct SDL_Surface;
 namespace dae
 {
 	class Scene;
+	struct ShadowCache;
 
 	class ColorManager {
 	public:
@@ -33,7 +40,7 @@ namespace dae
 
 		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
 
-		ColorRGB CalculateColor(Scene* pScene, HitRecord* pHit, const Vector3& viewDir) const;
+		ColorRGB CalculateColor(Scene* pScene, HitRecord* pHit, const Vector3& viewDir, ShadowCache* pShadowCache = nullptr) const;
 
 	private:
 		enum LightingMode {
@@ -63,6 +70,8 @@ namespace dae
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
+		//Offscreen renderer without a window, frames go to an in-memory framebuffer
+		Renderer(uint32_t width, uint32_t height);
 		~Renderer() = default;
 
 		Renderer(const Renderer&) = delete;
@@ -70,9 +79,56 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Matrix cameraToWorld, const Vector3 cameraOrigin) const;
-		bool SaveBufferToImage() const;
+		//Traces the primary rays of the frame into the G-buffer, then shades it
+		void Render(Scene* pScene);
+		//Runs only the shading stage on the G-buffer of the last frame, e.g. after switching the lighting mode.
+		//A progressive image restarts from the reshaded last sample. Does nothing after a cancelled RenderRefining, its G-buffer is only partly traced.
+		void Shade(Scene* pScene);
+		//Interactive preview: traces one ray per 8x8 block, then per 4x4, 2x2 and every pixel, presenting after every level.
+		//Returns false when isCancelled returned true before the frame was complete, the buffer then holds the coarser levels.
+		bool RenderRefining(Scene* pScene, const std::function<bool()>& isCancelled = {});
+		//Like SDL_SaveBMP, returns false when the image was saved
+		bool SaveBufferToImage(const std::string& filename = "RayTracing_Buffer.bmp") const;
+
+		const uint32_t* GetBufferPixels() const { return m_pBufferPixels; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+		//Worker threads of the renderer, scenes build their acceleration structures on them as well
+		ThreadPool& GetThreadPool() { return m_ThreadPool; }
+
+		//Renders at scale times the output resolution and upscales to the output, 1 renders every pixel
+		void SetRenderScale(float scale);
+		int GetRenderWidth() const { return m_RenderWidth; }
+		int GetRenderHeight() const { return m_RenderHeight; }
+
+		//Shadow rays traced since the renderer was created, how many were blocked and how many of those by the occluder cached for their light
+		uint64_t GetNrShadowRays() const { return m_NrShadowRays.load(); }
+		uint64_t GetNrOccludedShadowRays() const { return m_NrOccludedShadowRays.load(); }
+		uint64_t GetNrShadowCacheHits() const { return m_NrShadowCacheHits.load(); }
+
+		void TogglePacketTracing() {
+			m_UsePacketTracing = !m_UsePacketTracing;
+			std::cout << "\n\nPACKET TRACING : " << (m_UsePacketTracing ? "On" : "Off") << std::endl;
+		}
+
+		void ToggleProgressive() {
+			m_UseProgressive = !m_UseProgressive;
+			ResetAccumulation();
+			std::cout << "\n\nPROGRESSIVE : " << (m_UseProgressive ? "On" : "Off") << std::endl;
+		}
+		//Call whenever the next frame would differ from the accumulated ones: camera, scene or lighting settings changed
+		void ResetAccumulation() { m_NrAccumulatedFrames = 0; }
+		//Samples per pixel in the current image, 0 when not accumulating
+		uint32_t GetNrAccumulatedFrames() const { return m_NrAccumulatedFrames; }
+
+		void ToggleAdaptiveSampling() {
+			m_UseAdaptiveSampling = !m_UseAdaptiveSampling;
+			std::cout << "\n\nADAPTIVE ANTI-ALIASING : " << (m_UseAdaptiveSampling ? "On" : "Off") << std::endl;
+		}
+		//Extra rays per frame the adaptive sampling may spend, as a fraction of the number of pixels
+		void SetAdaptiveRayBudget(float raysPerPixel) { m_AdaptiveRayBudget = raysPerPixel; }
+		//Pixels that got extra samples in the last frame
+		uint32_t GetNrAdaptivePixels() const { return static_cast<uint32_t>(m_AdaptivePixels.size()); }
 
 		ColorManager m_colorManager{};
 
@@ -81,9 +137,92 @@ namespace dae
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		std::vector<uint32_t> m_OffscreenPixels{};
 
 		int m_Width{};
 		int m_Height{};
 
+		//Resolution the frame is traced and shaded at. Below the output resolution it goes to m_ScaledPixels and is upscaled after shading.
+		int m_RenderWidth{};
+		int m_RenderHeight{};
+		uint32_t* m_pRenderPixels{};
+		std::vector<uint32_t> m_ScaledPixels{};
+
+		//Screen is split in square tiles, which the thread pool hands out and steals between workers
+		static constexpr uint32_t TileSize{ 16 };
+		uint32_t m_NrTilesX{};
+		uint32_t m_NrTilesY{};
+		ThreadPool m_ThreadPool{};
+
+		//The trace stage fills the G-buffer, the shading stage works through its pixels grouped by material in chunks
+		static constexpr uint32_t ShadingChunkSize{ 256 };
+		GBuffer m_GBuffer{};
+		//False while the G-buffer holds a mix of two frames, RenderRefining fills it one level at a time
+		bool m_IsGBufferComplete{ false };
+		//Camera of the frame in the G-buffer, the shading stage rebuilds the view directions from it
+		Matrix m_FrameCameraToWorld{};
+		float m_FrameFov{};
+		float m_FrameAspectRatio{};
+
+		//Block size of the first level of RenderRefining, tiles have to be a multiple of it
+		static constexpr uint32_t MaxRefinementBlockSize{ 8 };
+		static_assert(TileSize % MaxRefinementBlockSize == 0);
+
+		//Primary rays are traced in packets of neighbouring pixels, single rays are the reference
+		bool m_UsePacketTracing{ true };
+
+		//Progressive mode: while nothing changes every frame adds one jittered sample per pixel to the accumulation buffer,
+		//once MaxAccumulatedFrames samples are in the image has converged and frames are skipped
+		static constexpr uint32_t MaxAccumulatedFrames{ 64 };
+		bool m_UseProgressive{ false };
+		uint32_t m_NrAccumulatedFrames{};
+		std::vector<ColorRGB> m_Accumulation{};
+		//Position within the pixel the primary rays of the frame go through, the centre unless jittered
+		float m_FrameSampleX{ 0.5f };
+		float m_FrameSampleY{ 0.5f };
+
+		//Adaptive anti-aliasing: after shading, the pixels with the highest contrast to their neighbours get
+		//AdaptiveSamplesPerPixel extra samples, as many as the ray budget allows. Flat regions keep their single sample.
+		static constexpr uint32_t AdaptiveSamplesPerPixel{ 4 };
+		static constexpr float AdaptiveContrastThreshold{ 0.05f };
+		bool m_UseAdaptiveSampling{ false };
+		float m_AdaptiveRayBudget{ 0.5f };
+		//Color of the centre sample of every pixel in the frame, before mapping
+		std::vector<ColorRGB> m_PixelColors{};
+		std::vector<float> m_PixelContrast{};
+		std::vector<uint32_t> m_AdaptivePixels{};
+
+		//Every shading chunk keeps its own ShadowCache, the counters are summed up when the chunk is done
+		mutable std::atomic<uint64_t> m_NrShadowRays{};
+		mutable std::atomic<uint64_t> m_NrOccludedShadowRays{};
+		mutable std::atomic<uint64_t> m_NrShadowCacheHits{};
+
+		void InitializeTiles();
+		//Prepares the acceleration structure and the camera of the frame
+		void BeginFrame(Scene* pScene);
+		//Upscales the frame when rendering below the output resolution and shows it in the window
+		void Present();
+		void TraceTile(Scene* pScene, uint32_t tileIndex, const Vector3& cameraOrigin);
+		//Traces the blocks of one refinement level in a tile and fills every block with its color
+		void RefineTile(Scene* pScene, uint32_t tileIndex, uint32_t blockSize, const Vector3& cameraOrigin);
+		//Traces the pixels of a block starting at (px, py) as one RayPacket, pixels past endX or endY are left out
+		void TracePacket(Scene* pScene, uint32_t px, uint32_t py, uint32_t endX, uint32_t endY, const Vector3& cameraOrigin);
+		//The shading stage of a frame, Render continues the accumulation with it
+		void ShadeGBuffer(Scene* pScene);
+		void ShadeChunk(Scene* pScene, uint32_t chunkIndex);
+		//sampleX and sampleY place the ray within the pixel, (0.5, 0.5) is its centre
+		Vector3 CalculateRayDirection(uint32_t px, uint32_t py, float fov, float aspectRatio, const Matrix& cameraToWorld, float sampleX = 0.5f, float sampleY = 0.5f) const;
+		ColorRGB ShadePixel(Scene* pScene, HitRecord& closestHit, const Vector3& viewDir, ShadowCache* pShadowCache) const;
+		//Writes the color of a frame to the pixel, or adds it to the pixel's samples when accumulating
+		void WritePixel(uint32_t pixelIndex, const ColorRGB& color);
+		//Picks the pixels for adaptive sampling from the shaded frame, then adds their extra samples
+		void SampleAdaptively(Scene* pScene);
+		float CalculateContrast(uint32_t px, uint32_t py) const;
+		void SampleAdaptiveChunk(Scene* pScene, uint32_t chunkIndex);
+		void Upscale();
+		uint32_t MapColor(const ColorRGB& color) const;
+		uint32_t MapColor(uint8_t r, uint8_t g, uint8_t b) const;
+		void UnmapColor(uint32_t pixel, uint8_t rgb[3]) const;
+
 	};
 }
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// Define SIMD_MATH to run the hot Vector3 and Matrix operations on SSE registers.
+// The scalar code stays the reference, both paths round the same way and render identical images.
+#if defined(SIMD_MATH)
+#define SIMD_ALIGN alignas(16)
+#else
+#define SIMD_ALIGN
+#endif
+
+// Width of the wide kernels (FloatN): 8 lanes when compiled for AVX, 4 with the SSE2 every x64 target has, 1 lane elsewhere.
+#if defined(__AVX__)
+#define SIMD_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE
+#include <emmintrin.h>
+#elif defined(SIMD_MATH)
+#include <xmmintrin.h>
+#endif
+
+namespace dae
+{
+	namespace SIMD
+	{
+		// Lane mask, the result of comparing two FloatN.
+		struct MaskN
+		{
+#if defined(SIMD_AVX)
+			__m256 value;
+
+			MaskN operator|(MaskN other) const { return { _mm256_or_ps(value, other.value) }; }
+			MaskN operator&(MaskN other) const { return { _mm256_and_ps(value, other.value) }; }
+			// Lanes set in this mask but not in other
+			MaskN AndNot(MaskN other) const { return { _mm256_andnot_ps(other.value, value) }; }
+			// Bit i is set when lane i is set
+			uint32_t GetBits() const { return static_cast<uint32_t>(_mm256_movemask_ps(value)); }
+#elif defined(SIMD_SSE)
+			__m128 value;
+
+			MaskN operator|(MaskN other) const { return { _mm_or_ps(value, other.value) }; }
+			MaskN operator&(MaskN other) const { return { _mm_and_ps(value, other.value) }; }
+			MaskN AndNot(MaskN other) const { return { _mm_andnot_ps(other.value, value) }; }
+			uint32_t GetBits() const { return static_cast<uint32_t>(_mm_movemask_ps(value)); }
+#else
+			bool value;
+
+			MaskN operator|(MaskN other) const { return { value || other.value }; }
+			MaskN operator&(MaskN other) const { return { value && other.value }; }
+			MaskN AndNot(MaskN other) const { return { value && !other.value }; }
+			uint32_t GetBits() const { return value ? 1u : 0u; }
+#endif
+		};
+
+		// A register of floats, operated on lane by lane. Division is exact (no reciprocal estimates), so every lane rounds like scalar code.
+		struct FloatN
+		{
+#if defined(SIMD_AVX)
+			static constexpr uint32_t Width{ 8 };
+			__m256 value;
+
+			static FloatN Load(const float* pValues) { return { _mm256_loadu_ps(pValues) }; }
+			static FloatN Broadcast(float value) { return { _mm256_set1_ps(value) }; }
+			void Store(float* pValues) const { _mm256_storeu_ps(pValues, value); }
+			// Width bytes widened to floats, 0 to 255
+			static FloatN LoadBytes(const uint8_t* pValues)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pValues)), zero);
+				const __m256i ints = _mm256_insertf128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(words, zero)), _mm_unpackhi_epi16(words, zero), 1);
+				return { _mm256_cvtepi32_ps(ints) };
+			}
+
+			FloatN operator+(FloatN other) const { return { _mm256_add_ps(value, other.value) }; }
+			FloatN operator-(FloatN other) const { return { _mm256_sub_ps(value, other.value) }; }
+			FloatN operator*(FloatN other) const { return { _mm256_mul_ps(value, other.value) }; }
+			FloatN operator/(FloatN other) const { return { _mm256_div_ps(value, other.value) }; }
+
+			static FloatN Min(FloatN a, FloatN b) { return { _mm256_min_ps(a.value, b.value) }; }
+			static FloatN Max(FloatN a, FloatN b) { return { _mm256_max_ps(a.value, b.value) }; }
+
+			// Ordered comparisons, false when either lane is NaN just like the scalar operators
+			MaskN operator<(FloatN other) const { return { _mm256_cmp_ps(value, other.value, _CMP_LT_OQ) }; }
+			MaskN operator>(FloatN other) const { return { _mm256_cmp_ps(value, other.value, _CMP_GT_OQ) }; }
+			MaskN operator>=(FloatN other) const { return { _mm256_cmp_ps(value, other.value, _CMP_GE_OQ) }; }
+
+			// Mask of the first count lanes
+			static MaskN FirstLanes(uint32_t count)
+			{
+				const __m256 laneIndices = _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f);
+				return { _mm256_cmp_ps(laneIndices, _mm256_set1_ps(static_cast<float>(count)), _CMP_LT_OQ) };
+			}
+#elif defined(SIMD_SSE)
+			static constexpr uint32_t Width{ 4 };
+			__m128 value;
+
+			static FloatN Load(const float* pValues) { return { _mm_loadu_ps(pValues) }; }
+			static FloatN Broadcast(float value) { return { _mm_set1_ps(value) }; }
+			void Store(float* pValues) const { _mm_storeu_ps(pValues, value); }
+			static FloatN LoadBytes(const uint8_t* pValues)
+			{
+				int32_t bytes;
+				std::memcpy(&bytes, pValues, sizeof(bytes));
+				const __m128i zero = _mm_setzero_si128();
+				return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero)) };
+			}
+
+			FloatN operator+(FloatN other) const { return { _mm_add_ps(value, other.value) }; }
+			FloatN operator-(FloatN other) const { return { _mm_sub_ps(value, other.value) }; }
+			FloatN operator*(FloatN other) const { return { _mm_mul_ps(value, other.value) }; }
+			FloatN operator/(FloatN other) const { return { _mm_div_ps(value, other.value) }; }
+
+			static FloatN Min(FloatN a, FloatN b) { return { _mm_min_ps(a.value, b.value) }; }
+			static FloatN Max(FloatN a, FloatN b) { return { _mm_max_ps(a.value, b.value) }; }
+
+			MaskN operator<(FloatN other) const { return { _mm_cmplt_ps(value, other.value) }; }
+			MaskN operator>(FloatN other) const { return { _mm_cmpgt_ps(value, other.value) }; }
+			MaskN operator>=(FloatN other) const { return { _mm_cmpge_ps(value, other.value) }; }
+
+			static MaskN FirstLanes(uint32_t count)
+			{
+				const __m128 laneIndices = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+				return { _mm_cmplt_ps(laneIndices, _mm_set1_ps(static_cast<float>(count))) };
+			}
+#else
+			static constexpr uint32_t Width{ 1 };
+			float value;
+
+			static FloatN Load(const float* pValues) { return { *pValues }; }
+			static FloatN Broadcast(float value) { return { value }; }
+			void Store(float* pValues) const { *pValues = value; }
+			static FloatN LoadBytes(const uint8_t* pValues) { return { static_cast<float>(*pValues) }; }
+
+			FloatN operator+(FloatN other) const { return { value + other.value }; }
+			FloatN operator-(FloatN other) const { return { value - other.value }; }
+			FloatN operator*(FloatN other) const { return { value * other.value }; }
+			FloatN operator/(FloatN other) const { return { value / other.value }; }
+
+			static FloatN Min(FloatN a, FloatN b) { return { a.value < b.value ? a.value : b.value }; }
+			static FloatN Max(FloatN a, FloatN b) { return { a.value > b.value ? a.value : b.value }; }
+
+			MaskN operator<(FloatN other) const { return { value < other.value }; }
+			MaskN operator>(FloatN other) const { return { value > other.value }; }
+			MaskN operator>=(FloatN other) const { return { value >= other.value }; }
+
+			static MaskN FirstLanes(uint32_t count) { return { count > 0 }; }
+#endif
+		};
+	}
+}
@@ -1,7 +1,10 @@
+#include <limits>
+
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
 #include "Light.h"
+#include "MeshCache.h"
 #include "TriangleMesh.h"
 
 namespace dae {
@@ -9,82 +12,245 @@ namespace dae {
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})})
+		m_Materials({ Material::SolidColor({1,0,0}) })
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
-		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
 		m_TriangleGeometries.reserve(32);
 	}
 
-	Scene::~Scene()
+	Scene::~Scene() = default;
+
+	// Refit the top level BVH to the bounds of every sphere, triangle and mesh. Has to run after the scene moved anything.
+	void Scene::UpdateAccelerationStructure()
 	{
-		for(auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
+		const size_t nrPrimitives = m_SphereGeometries.size() + m_TriangleGeometries.size() + m_TriangleMeshGeometries.size();
+
+		std::vector<Vector3>& primitiveMins = m_TopLevelPrimitiveMins;
+		std::vector<Vector3>& primitiveMaxs = m_TopLevelPrimitiveMaxs;
+		primitiveMins.clear();
+		primitiveMaxs.clear();
+		primitiveMins.reserve(nrPrimitives);
+		primitiveMaxs.reserve(nrPrimitives);
+
+		m_TopLevelPrimitives.clear();
+		m_TopLevelPrimitives.reserve(nrPrimitives);
+
+		for (uint32_t i = 0; i < m_SphereGeometries.size(); i++) {
+			const Sphere& sphere = m_SphereGeometries[i];
+			const Vector3 radius{ sphere.radius, sphere.radius, sphere.radius };
+
+			primitiveMins.emplace_back(sphere.origin - radius);
+			primitiveMaxs.emplace_back(sphere.origin + radius);
+			m_TopLevelPrimitives.push_back({ PrimitiveType::Sphere, i });
+		}
+
+		for (uint32_t i = 0; i < m_TriangleGeometries.size(); i++) {
+			const Triangle& triangle = m_TriangleGeometries[i];
+
+			primitiveMins.emplace_back(Vector3::Min(triangle.v0, Vector3::Min(triangle.v1, triangle.v2)));
+			primitiveMaxs.emplace_back(Vector3::Max(triangle.v0, Vector3::Max(triangle.v1, triangle.v2)));
+			m_TopLevelPrimitives.push_back({ PrimitiveType::Triangle, i });
+		}
+
+		// Meshes only contribute their bounds, each one traverses its own BVH once the ray reaches it.
+		for (uint32_t i = 0; i < m_TriangleMeshGeometries.size(); i++) {
+			const TriangleMesh& mesh = m_TriangleMeshGeometries[i];
+			if (mesh.GetGeometry().bvh.IsEmpty())
+				continue;
+
+			primitiveMins.emplace_back(mesh.minAABB);
+			primitiveMaxs.emplace_back(mesh.maxAABB);
+			m_TopLevelPrimitives.push_back({ PrimitiveType::TriangleMesh, i });
 		}
 
-		m_Materials.clear();
+		m_TopLevelBVH.Refit(primitiveMins, primitiveMaxs);
 	}
 
 	// Find the closest hit within the scene for a given ray. The solution will be saved in the hitrecord if any hit was found.
 	void Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
-		for (const Sphere& sphere : m_SphereGeometries) {
-			GeometryUtils::HitTest_Sphere(sphere, ray, closestHit);
-		};
-
+		// Planes first, they are cheap and give the BVH a closer hit to cull against.
 		for (const Plane& plane : m_PlaneGeometries) {
 			GeometryUtils::HitTest_Plane(plane, ray, closestHit);
 		}
-		for (const Triangle& triangle : m_TriangleGeometries) {
-			GeometryUtils::HitTest_Triangle(triangle, ray, closestHit);
-		}
 
-		for (const TriangleMesh& tm : m_TriangleMeshGeometries) {
-			GeometryUtils::HitTest_TriangleMesh(tm, ray, closestHit);
+		GeometryUtils::Traverse_BVH(m_TopLevelBVH, ray, closestHit, [&](uint32_t primitiveIndex) {
+			const PrimitiveReference& primitive = m_TopLevelPrimitives[primitiveIndex];
+			switch (primitive.type) {
+			case PrimitiveType::Sphere:
+				GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray, closestHit);
+				break;
+			case PrimitiveType::Triangle:
+				GeometryUtils::HitTest_Triangle(m_TriangleGeometries[primitive.index], ray, closestHit);
+				break;
+			case PrimitiveType::TriangleMesh:
+				GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], ray, closestHit);
+				break;
+			case PrimitiveType::Plane:
+				assert(false && "Planes are never in the top level BVH");
+				break;
+			}
+			return false;
+			});
+	}
+
+	// GetClosestHit for a packet of rays, hitRecords holds a record for every lane of the packet.
+	void Scene::GetClosestHits(const RayPacket& packet, HitRecord* hitRecords) const
+	{
+		for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+			if (!(packet.laneMask & (1u << lane)))
+				continue;
+
+			const Ray ray = packet.GetRay(lane);
+			for (const Plane& plane : m_PlaneGeometries) {
+				GeometryUtils::HitTest_Plane(plane, ray, hitRecords[lane]);
+			}
 		}
+
+		GeometryUtils::Traverse_BVHPacket(m_TopLevelBVH, packet, hitRecords, packet.laneMask, [&](uint32_t primitiveIndex, uint32_t lanes) {
+			const PrimitiveReference& primitive = m_TopLevelPrimitives[primitiveIndex];
+			switch (primitive.type) {
+			case PrimitiveType::Sphere:
+				GeometryUtils::HitTest_SpherePacket(m_SphereGeometries[primitive.index], packet, hitRecords, lanes);
+				break;
+			case PrimitiveType::Triangle:
+				for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+					if (lanes & (1u << lane))
+						GeometryUtils::HitTest_Triangle(m_TriangleGeometries[primitive.index], packet.GetRay(lane), hitRecords[lane]);
+				}
+				break;
+			case PrimitiveType::TriangleMesh:
+				GeometryUtils::HitTest_TriangleMeshPacket(m_TriangleMeshGeometries[primitive.index], packet, hitRecords, lanes);
+				break;
+			case PrimitiveType::Plane:
+				assert(false && "Planes are never in the top level BVH");
+				break;
+			}
+			});
 	}
 
 	// Find whether or not the ray hits anything in the scene.
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		for (const Sphere& sphere : m_SphereGeometries) {
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
-				return true;
-		};
-
 		for (const Plane& plane : m_PlaneGeometries) {
 			if (GeometryUtils::HitTest_Plane(plane, ray))
 				return true;
 		}
 
-		for (const Triangle& triangle : m_TriangleGeometries) {
-			if (GeometryUtils::HitTest_Triangle(triangle, ray))
+		const HitRecord noHit{};
+		return GeometryUtils::Traverse_BVH(m_TopLevelBVH, ray, noHit, [&](uint32_t primitiveIndex) {
+			const PrimitiveReference& primitive = m_TopLevelPrimitives[primitiveIndex];
+			switch (primitive.type) {
+			case PrimitiveType::Sphere:
+				return GeometryUtils::HitTest_Sphere(m_SphereGeometries[primitive.index], ray);
+			case PrimitiveType::Triangle:
+				return GeometryUtils::HitTest_Triangle(m_TriangleGeometries[primitive.index], ray);
+			case PrimitiveType::TriangleMesh:
+				return GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[primitive.index], ray);
+			case PrimitiveType::Plane:
+				assert(false && "Planes are never in the top level BVH");
+				return false;
+			}
+			return false;
+			});
+	}
+
+	// Whether anything blocks a shadow ray, gives the same answer as DoesHit through the lean any-hit kernels.
+	bool Scene::IsOccluded(const Ray& ray, ShadowOccluder* pOccluder) const
+	{
+		for (uint32_t planeIndex = 0; planeIndex < m_PlaneGeometries.size(); planeIndex++) {
+			if (GeometryUtils::Occludes_Plane(m_PlaneGeometries[planeIndex], ray)) {
+				if (pOccluder)
+					*pOccluder = ShadowOccluder{ { PrimitiveType::Plane, planeIndex }, 0, true };
 				return true;
+			}
 		}
 
-		for (const TriangleMesh& tm : m_TriangleMeshGeometries) {
-			if (GeometryUtils::HitTest_TriangleMesh(tm, ray))
-				return true;
+		return GeometryUtils::Traverse_BVHOcclusion(m_TopLevelBVH, ray, [&](uint32_t firstSlot, uint32_t primitiveCount) {
+			for (uint32_t slot = firstSlot; slot < firstSlot + primitiveCount; slot++) {
+				const PrimitiveReference& primitive = m_TopLevelPrimitives[m_TopLevelBVH.primitiveIndices[slot]];
+				bool occluded = false;
+				uint32_t triangleSlot = 0;
+				switch (primitive.type) {
+				case PrimitiveType::Sphere:
+					occluded = GeometryUtils::Occludes_Sphere(m_SphereGeometries[primitive.index], ray);
+					break;
+				case PrimitiveType::Triangle:
+					occluded = GeometryUtils::Occludes_Triangle(m_TriangleGeometries[primitive.index], ray);
+					break;
+				case PrimitiveType::TriangleMesh:
+					occluded = GeometryUtils::Occludes_TriangleMesh(m_TriangleMeshGeometries[primitive.index], ray, &triangleSlot);
+					break;
+				case PrimitiveType::Plane:
+					assert(false && "Planes are never in the top level BVH");
+					break;
+				}
+				if (occluded) {
+					if (pOccluder)
+						*pOccluder = ShadowOccluder{ primitive, triangleSlot, true };
+					return true;
+				}
+			}
+			return false;
+			});
+	}
+
+	bool Scene::IsOccluded(const Ray& ray, ShadowCache* pShadowCache, size_t lightIndex) const
+	{
+		if (!pShadowCache || lightIndex >= ShadowCache::MaxLights)
+			return IsOccluded(ray);
+
+		++pShadowCache->nrShadowRays;
+		ShadowOccluder& occluder = pShadowCache->occluders[lightIndex];
+		bool& wasOccluded = pShadowCache->wasOccluded[lightIndex];
+		if (wasOccluded && Occludes(occluder, ray)) {
+			++pShadowCache->nrOccluded;
+			++pShadowCache->nrHits;
+			return true;
+		}
+
+		ShadowOccluder newOccluder{};
+		wasOccluded = IsOccluded(ray, &newOccluder);
+		if (!wasOccluded)
+			return false;
+
+		++pShadowCache->nrOccluded;
+		occluder = newOccluder;
+		return true;
+	}
+
+	// Tests a single cached occluder. Meshes only test the packed triangles that blocked the previous ray.
+	bool Scene::Occludes(const ShadowOccluder& occluder, const Ray& ray) const
+	{
+		const uint32_t index = occluder.primitive.index;
+		switch (occluder.primitive.type) {
+		case PrimitiveType::Sphere:
+			return index < m_SphereGeometries.size() && GeometryUtils::Occludes_Sphere(m_SphereGeometries[index], ray);
+		case PrimitiveType::Triangle:
+			return index < m_TriangleGeometries.size() && GeometryUtils::Occludes_Triangle(m_TriangleGeometries[index], ray);
+		case PrimitiveType::TriangleMesh:
+			return index < m_TriangleMeshGeometries.size() && GeometryUtils::Occludes_TriangleMeshSlots(m_TriangleMeshGeometries[index], ray, occluder.slot);
+		case PrimitiveType::Plane:
+			return index < m_PlaneGeometries.size() && GeometryUtils::Occludes_Plane(m_PlaneGeometries[index], ray);
 		}
 		return false;
 	}
 
 	// Calculates the relative amount of light hitting a point, given by a hit record. Cosine area rule.
-	ColorRGB Scene::GetObservedArea(const HitRecord* pHit, bool shadowsEnabled) const
+	ColorRGB Scene::GetObservedArea(const HitRecord* pHit, bool shadowsEnabled, ShadowCache* pShadowCache) const
 	{
 		float cosine = 0;
 
-		for (const Light& light : m_Lights) {
+		for (size_t lightIndex = 0; lightIndex < m_Lights.size(); lightIndex++) {
+			const Light& light = m_Lights[lightIndex];
 			Vector3 lightDir = light.GetDirectionToLight(pHit->origin).Normalized();
 			float area = Vector3::Dot(lightDir, pHit->normal);
 			if (area > 0) {
 				Ray lightRay = light.CreateLightRay(pHit->origin);
 
-				if (!shadowsEnabled || !DoesHit(lightRay))
+				if (!shadowsEnabled || !IsOccluded(lightRay, pShadowCache, lightIndex))
 					cosine += area;
 			}
 		}
@@ -93,50 +259,54 @@ namespace dae {
 	}
 
 	// Calculates the radiance hitting a point, given by a hit record.
-	ColorRGB Scene::GetRadiance(const HitRecord* pHit, bool shadowsEnabled) const
+	ColorRGB Scene::GetRadiance(const HitRecord* pHit, bool shadowsEnabled, ShadowCache* pShadowCache) const
 	{
 		ColorRGB color{};
 
-		for (const Light& light : m_Lights) {
+		for (size_t lightIndex = 0; lightIndex < m_Lights.size(); lightIndex++) {
+			const Light& light = m_Lights[lightIndex];
 			Ray lightRay = light.CreateLightRay(pHit->origin);
 
-			if (!shadowsEnabled || !DoesHit(lightRay))
+			if (!shadowsEnabled || !IsOccluded(lightRay, pShadowCache, lightIndex))
 				color += LightUtils::GetRadiance(light, pHit->origin);
 		}
 		return color;
 	}
 
 	// Calculates the BRDF ina given point. 
-	ColorRGB Scene::GetBRDF(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir) const
+	ColorRGB Scene::GetBRDF(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir, ShadowCache* pShadowCache) const
 	{
 		ColorRGB color{};
+		const Material& material = m_Materials[pHit->materialIndex];
 
-		for (const Light& light : m_Lights) {
-			Ray lightRay = light.CreateLightRay(pHit->origin);
+		for (size_t lightIndex = 0; lightIndex < m_Lights.size(); lightIndex++) {
+			Ray lightRay = m_Lights[lightIndex].CreateLightRay(pHit->origin);
 
-			if (!shadowsEnabled || !DoesHit(lightRay)) {
-				color += m_Materials[pHit->materialIndex]->Shade(*pHit, lightRay.direction, viewDir);
+			if (!shadowsEnabled || !IsOccluded(lightRay, pShadowCache, lightIndex)) {
+				color += material.Shade(*pHit, lightRay.direction, viewDir);
 			}
 		}
 		return color;
 	}
 
-	ColorRGB Scene::GetColour(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir) const
+	ColorRGB Scene::GetColour(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir, ShadowCache* pShadowCache) const
 	{
 		float cosine = 0;
 		ColorRGB color{};
+		const Material& material = m_Materials[pHit->materialIndex];
 
-		for (const Light& light : m_Lights) {
+		for (size_t lightIndex = 0; lightIndex < m_Lights.size(); lightIndex++) {
+			const Light& light = m_Lights[lightIndex];
 			Vector3 lightDir = light.GetDirectionToLight(pHit->origin).Normalized();
 			float area = Vector3::Dot(lightDir, pHit->normal);
 
 			if (area > 0) {
 				Ray lightRay = light.CreateLightRay(pHit->origin);
 
-				if (!shadowsEnabled || !DoesHit(lightRay)) {
+				if (!shadowsEnabled || !IsOccluded(lightRay, pShadowCache, lightIndex)) {
 					ColorRGB radiance = LightUtils::GetRadiance(light, pHit->origin);
 					ColorRGB newColor = radiance * area;
-					color += m_Materials[pHit->materialIndex]->Shade(*pHit, lightRay.direction, viewDir) * newColor;
+					color += material.Shade(*pHit, lightRay.direction, viewDir) * newColor;
 				}
 			}
 		}
@@ -145,7 +315,7 @@ namespace dae {
 	}
 
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	Sphere* Scene::AddSphere(const Vector3& origin, float radius, MaterialIndex materialIndex)
 	{
 		Sphere s;
 		s.origin = origin;
@@ -156,7 +326,7 @@ namespace dae {
 		return &m_SphereGeometries.back();
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, MaterialIndex materialIndex)
 	{
 		Plane p;
 		p.origin = origin;
@@ -167,11 +337,48 @@ namespace dae {
 		return &m_PlaneGeometries.back();
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	void Scene::SetThreadPool(ThreadPool* pThreadPool)
+	{
+		m_pThreadPool = pThreadPool;
+		m_TopLevelBVH.SetThreadPool(pThreadPool);
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries)
+			mesh.bvh.SetThreadPool(pThreadPool);
+	}
+
+	void Scene::SetBVHLayout(BVHLayout bvhLayout)
+	{
+		m_BVHLayout = bvhLayout;
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries) {
+			mesh.bvhLayout = bvhLayout;
+			// Meshes that are already built collapse their tree now, instances walk the one of their source
+			if (bvhLayout == BVHLayout::Wide8 && !mesh.pInstanceSource && !mesh.bvh.IsEmpty())
+				mesh.bvh8.Build(mesh.bvh);
+			else if (bvhLayout == BVHLayout::Binary)
+				mesh.bvh8 = {};
+		}
+	}
+
+	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, MaterialIndex materialIndex)
 	{
 		TriangleMesh m{};
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
+		m.bvh.SetThreadPool(m_pThreadPool);
+		m.bvhLayout = m_BVHLayout;
+
+		m_TriangleMeshGeometries.emplace_back(m);
+		return &m_TriangleMeshGeometries.back();
+	}
+
+	TriangleMesh* Scene::AddTriangleMeshInstance(const TriangleMesh* pSource, TriangleCullMode cullMode, MaterialIndex materialIndex)
+	{
+		assert(pSource->isInstanced && !pSource->pInstanceSource);
+
+		TriangleMesh m{};
+		m.cullMode = cullMode;
+		m.materialIndex = materialIndex;
+		m.isInstanced = true;
+		m.pInstanceSource = pSource;
 
 		m_TriangleMeshGeometries.emplace_back(m);
 		return &m_TriangleMeshGeometries.back();
@@ -201,10 +408,11 @@ namespace dae {
 		return &m_Lights.back();
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	MaterialIndex Scene::AddMaterial(const Material& material)
 	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
+		assert(m_Materials.size() <= std::numeric_limits<MaterialIndex>::max() && "Material table is full");
+		m_Materials.push_back(material);
+		return static_cast<MaterialIndex>(m_Materials.size() - 1);
 	}
 #pragma endregion
 #pragma endregion
@@ -213,12 +421,12 @@ namespace dae {
 	void Scene_W1::Initialize()
 	{
 				//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialIndex matId_Solid_Red = 0;
+		const MaterialIndex matId_Solid_Blue = AddMaterial(Material::SolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialIndex matId_Solid_Yellow = AddMaterial(Material::SolidColor(colors::Yellow));
+		const MaterialIndex matId_Solid_Green = AddMaterial(Material::SolidColor(colors::Green));
+		const MaterialIndex matId_Solid_Magenta = AddMaterial(Material::SolidColor(colors::Magenta));
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -240,12 +448,12 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 		
 		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialIndex matId_Solid_Red = 0;
+		const MaterialIndex matId_Solid_Blue = AddMaterial(Material::SolidColor(colors::Blue));
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialIndex matId_Solid_Yellow = AddMaterial(Material::SolidColor(colors::Yellow));
+		const MaterialIndex matId_Solid_Green = AddMaterial(Material::SolidColor(colors::Green));
+		const MaterialIndex matId_Solid_Magenta = AddMaterial(Material::SolidColor(colors::Magenta));
 
 		//Spheres
 		AddSphere({ -1.75f, 1.f, 0.f }, .75f, matId_Solid_Red);
@@ -274,15 +482,15 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -290,9 +498,9 @@ namespace dae {
 		AddPlane(Vector3{ 5.f, 0.f, 0.f }, Vector3{ -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
 		AddPlane(Vector3{ -5.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
-		//const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, .5f, 3.f));
-		//const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, .5f, 15.f));
-		//const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, .5f, 50.f));
+		//const auto matLambertPhong1 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, .5f, 3.f));
+		//const auto matLambertPhong2 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, .5f, 15.f));
+		//const auto matLambertPhong3 = AddMaterial(Material::LambertPhong(colors::Blue, 0.5f, .5f, 50.f));
 
 		//AddSphere(Vector3{ -1.75f, 1.f, 0.f }, .75f, matLambertPhong1);
 		//AddSphere(Vector3{ 0.f, 1.f, 0.f }, .75f, matLambertPhong2);
@@ -320,8 +528,8 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
@@ -361,13 +569,11 @@ namespace dae {
 		//OBJ
 		//===
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/simple_cube.obj",
-		//Utils::ParseOBJ("Resources/simple_object.obj",
-			pMesh->positions, 
-			pMesh->normals, 
-			pMesh->indices);
+		pMesh->isInstanced = true; //Rigidly animated in Update, no need to re-transform every vertex
+		Utils::LoadOBJCached("Resources/simple_cube.obj", *pMesh, m_pThreadPool);
+		//Utils::LoadOBJCached("Resources/simple_object.obj", *pMesh, m_pThreadPool);
 
-		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
+		//No need to Calculate the normals, these are loaded with the mesh
 		pMesh->UpdateTransforms();
 
 		pMesh->Scale({ .7f,.7f,.7f });
@@ -379,12 +585,13 @@ namespace dae {
 		AddPointLight(Vector3{ -2.5f, 5.f, -5.f }, 70.f, ColorRGB{ 1.f, .8f, .45f }); //Front Light Left
 		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
 	}
-	void Scene_W4::Update(Timer* pTimer)
+	bool Scene_W4::Update(Timer* pTimer)
 	{
 		Scene::Update(pTimer);
 
 		pMesh->RotateY(15 * pTimer->GetTotal());
 		pMesh->UpdateTransforms();
+		return true;
 	}
 	void Scene_W4_ReferenceScene::Initialize()
 	{
@@ -392,15 +599,15 @@ namespace dae {
 		m_Camera.origin = { 0,3,-9 };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
+		const auto matCT_GrayMediumMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
+		const auto matCT_GraySmoothMetal = AddMaterial(Material::CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
+		const auto matCT_GrayRoughPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, 1.f));
+		const auto matCT_GrayMediumPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .6f));
+		const auto matCT_GraySmoothPlastic = AddMaterial(Material::CookTorrence({ .75f, .75f, .75f }, .0f, .1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
 		AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, matLambert_GrayBlue); //BOTTOM
@@ -418,18 +625,18 @@ namespace dae {
 		//CW Winding Order!
 		const Triangle baseTriangle = { Vector3(-.75f, 1.5f, 0.f), Vector3(.75f, 0.f, 0.f), Vector3(-.75f, 0.f, 0.f) };
 
+		//The three meshes only differ in transform and culling, so they share a single instanced copy of the triangle
 		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		m_Meshes[0]->isInstanced = true;
 		m_Meshes[0]->AppendTriangle(baseTriangle, true);
 		m_Meshes[0]->Translate({ -1.75f,4.5f,0.f });
 		m_Meshes[0]->UpdateTransforms();
 
-		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
+		m_Meshes[1] = AddTriangleMeshInstance(m_Meshes[0], TriangleCullMode::FrontFaceCulling, matLambert_White);
 		m_Meshes[1]->Translate({ 0.f,4.5f,0.f });
 		m_Meshes[1]->UpdateTransforms();
 
-		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
+		m_Meshes[2] = AddTriangleMeshInstance(m_Meshes[0], TriangleCullMode::NoCulling, matLambert_White);
 		m_Meshes[2]->Translate({ 1.75f,4.5f,0.f });
 		m_Meshes[2]->UpdateTransforms();
 
@@ -437,7 +644,7 @@ namespace dae {
 		AddPointLight(Vector3{ -2.5f, 5.f, -5.f }, 70.f, ColorRGB{ 1.f, .8f, .45f }); //Front Light Left
 		AddPointLight(Vector3{ 2.5f, 2.5f, -5.f }, 50.f, ColorRGB{ .34f, .47f, .68f });
 	}
-	void Scene_W4_ReferenceScene::Update(Timer* pTimer)
+	bool Scene_W4_ReferenceScene::Update(Timer* pTimer)
 	{
 		Scene::Update(pTimer);
 		const auto yawAngle = (cos(pTimer->GetTotal()) + 1.f) / 2.f * 180;
@@ -445,6 +652,7 @@ namespace dae {
 			m->RotateY(yawAngle);
 			m->UpdateTransforms();
 		}
+		return true;
 	}
 	void Scene_W4_BunnyScene::Initialize()
 	{
@@ -452,8 +660,8 @@ namespace dae {
 		m_Camera.fovAngle = 45.f;
 
 		//Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
 
 		//Planes
 		AddPlane(Vector3{ 0.f, 0.f, 10.f }, Vector3{ 0.f, 0.f, -1.f }, matLambert_GrayBlue); //BACK
@@ -465,13 +673,10 @@ namespace dae {
 		//OBJ
 		//===
 		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj",
-			//Utils::ParseOBJ("Resources/simple_object.obj",
-			pMesh->positions,
-			pMesh->normals,
-			pMesh->indices);
+		Utils::LoadOBJCached("Resources/lowpoly_bunny2.obj", *pMesh, m_pThreadPool);
+		//Utils::LoadOBJCached("Resources/simple_object.obj", *pMesh, m_pThreadPool);
 
-		//No need to Calculate the normals, these are calculated inside the ParseOBJ function
+		//No need to Calculate the normals, these are loaded with the mesh
 		pMesh->UpdateTransforms();
 
 
@@ -1,4 +1,5 @@
 #pragma once
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -7,16 +8,55 @@
 #include "TriangleMesh.h"
 #include "Camera.h"
 #include "Light.h"
+#include "Material.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
 
+	//Reference from a leaf of the top level BVH to the geometry it bounds
+	enum class PrimitiveType : unsigned char
+	{
+		Sphere,
+		Triangle,
+		TriangleMesh,
+		//Planes are never in the top level BVH, only shadow occluders refer to them
+		Plane
+	};
+
+	struct PrimitiveReference
+	{
+		PrimitiveType type{};
+		uint32_t index{};
+	};
+
+	//Primitive that blocked a shadow ray. For meshes, slot is the first of the packed triangles that were hit.
+	struct ShadowOccluder
+	{
+		PrimitiveReference primitive{};
+		uint32_t slot{};
+		bool isValid{};
+	};
+
+	//Remembers the last occluder of every light, neighbouring pixels are usually blocked by the same primitive.
+	//The occluder is only tried while the previous ray towards the light was blocked, most shadow rays are not and would pay for a useless test.
+	//Owned by a single thread, the renderer keeps one per tile.
+	struct ShadowCache
+	{
+		static constexpr uint32_t MaxLights{ 8 };
+		ShadowOccluder occluders[MaxLights]{};
+		bool wasOccluded[MaxLights]{};
+
+		//Shadow rays that went through the cache, how many of them were blocked and how many of those by the cached occluder
+		uint32_t nrShadowRays{};
+		uint32_t nrOccluded{};
+		uint32_t nrHits{};
+	};
+
 	//Scene Base Class
 	class Scene
 	{
@@ -30,24 +70,38 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
-		virtual void Update(dae::Timer* pTimer)
+		//Returns true when the next frame can differ from the last one, animated scenes always do
+		virtual bool Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			m_HasCameraMoved = m_Camera.Update(pTimer);
+			return m_HasCameraMoved;
 		}
+		//True when the last Update moved or turned the camera, the animation of the scene does not count
+		bool HasCameraMoved() const { return m_HasCameraMoved; }
 
 		Camera& GetCamera() { return m_Camera; }
+		//Worker threads the acceleration structures are built on, e.g. the renderer's. Set before Initialize.
+		void SetThreadPool(ThreadPool* pThreadPool);
+		//Tree every mesh is traversed through, the binary BVH or its wide copy. Meshes that are already built switch right away.
+		void SetBVHLayout(BVHLayout bvhLayout);
+		void UpdateAccelerationStructure();
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
+		void GetClosestHits(const RayPacket& packet, HitRecord* hitRecords) const;
 		bool DoesHit(const Ray& ray) const;
+		//Shadow ray query, same result as DoesHit. pOccluder receives the primitive that blocks the ray.
+		bool IsOccluded(const Ray& ray, ShadowOccluder* pOccluder = nullptr) const;
+		//Tests the occluder cached for the light first
+		bool IsOccluded(const Ray& ray, ShadowCache* pShadowCache, size_t lightIndex) const;
 
-		ColorRGB GetObservedArea(const HitRecord* pHit, bool shadowsEnabled) const;
-		ColorRGB GetRadiance(const HitRecord* pHit, bool shadowsEnabled) const;
-		ColorRGB GetBRDF(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir) const;
-		ColorRGB GetColour(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir) const;
+		ColorRGB GetObservedArea(const HitRecord* pHit, bool shadowsEnabled, ShadowCache* pShadowCache = nullptr) const;
+		ColorRGB GetRadiance(const HitRecord* pHit, bool shadowsEnabled, ShadowCache* pShadowCache = nullptr) const;
+		ColorRGB GetBRDF(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir, ShadowCache* pShadowCache = nullptr) const;
+		ColorRGB GetColour(const HitRecord* pHit, bool shadowsEnabled, const Vector3& viewDir, ShadowCache* pShadowCache = nullptr) const;
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material>& GetMaterials() const { return m_Materials; }
 
 	protected:
 		std::string	sceneName;
@@ -55,19 +109,35 @@ namespace dae
 		std::vector<Plane> m_PlaneGeometries{};
 		std::vector<Sphere> m_SphereGeometries{};
 		std::vector<Triangle> m_TriangleGeometries{};
-		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
+		//A deque, so adding meshes never moves the ones that instances and scenes point to
+		std::deque<TriangleMesh> m_TriangleMeshGeometries{};
 		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		//Material table, indexed by the materialIndex of the geometry
+		std::vector<Material> m_Materials{};
 
 		Camera m_Camera{};
+		bool m_HasCameraMoved{ false };
+
+		ThreadPool* m_pThreadPool{};
+		BVHLayout m_BVHLayout{ BVHLayout::Binary };
+
+		//Top level BVH over all bounded geometry, infinite planes are tested separately
+		BVH m_TopLevelBVH{};
+		std::vector<PrimitiveReference> m_TopLevelPrimitives{};
+		//Bounds of the top level primitives, kept from frame to frame so refitting does not allocate
+		std::vector<Vector3> m_TopLevelPrimitiveMins{};
+		std::vector<Vector3> m_TopLevelPrimitiveMaxs{};
+
+		bool Occludes(const ShadowOccluder& occluder, const Ray& ray) const;
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		Sphere* AddSphere(const Vector3& origin, float radius, MaterialIndex materialIndex = 0);
+		Plane* AddPlane(const Vector3& origin, const Vector3& normal, MaterialIndex materialIndex = 0);
+		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, MaterialIndex materialIndex = 0);
+		TriangleMesh* AddTriangleMeshInstance(const TriangleMesh* pSource, TriangleCullMode cullMode, MaterialIndex materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		MaterialIndex AddMaterial(const Material& material);
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -132,7 +202,7 @@ namespace dae
 		Scene_W4& operator=(Scene_W4&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		bool Update(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* pMesh{ nullptr };
@@ -152,7 +222,7 @@ namespace dae
 		Scene_W4_ReferenceScene& operator=(Scene_W4_ReferenceScene&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		bool Update(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* m_Meshes[3]{};
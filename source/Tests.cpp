@@ -1,5 +1,100 @@
 #include "Tests.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "DynamicResolution.h"
+#include "FramePipeline.h"
+#include "MappedFile.h"
+#include "Matrix.h"
+#include "MeshCache.h"
+#include "OBJLoader.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+#include "TriangleMesh.h"
+#include "Utils.h"
+
+std::atomic<size_t> Tests::s_NrAllocations{};
+
+// Replace every form of the global allocation functions so the tests can check when the heap is touched.
+// Plain and array forms share one pair of functions, the aligned forms another, so every delete matches its new.
+namespace
+{
+    void* Allocate(size_t size) noexcept
+    {
+        ++Tests::s_NrAllocations;
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void Deallocate(void* pMemory) noexcept
+    {
+        std::free(pMemory);
+    }
+
+    void* AllocateAligned(size_t size, std::align_val_t alignment) noexcept
+    {
+        ++Tests::s_NrAllocations;
+        const size_t alignmentSize{ static_cast<size_t>(alignment) };
+#if defined(_MSC_VER)
+        return _aligned_malloc(size == 0 ? 1 : size, alignmentSize);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignmentSize, ((size == 0 ? 1 : size) + alignmentSize - 1) / alignmentSize * alignmentSize);
+#endif
+    }
+
+    void DeallocateAligned(void* pMemory) noexcept
+    {
+#if defined(_MSC_VER)
+        _aligned_free(pMemory);
+#else
+        std::free(pMemory);
+#endif
+    }
+
+    void* ThrowIfNull(void* pMemory)
+    {
+        if (!pMemory)
+            throw std::bad_alloc{};
+        return pMemory;
+    }
+}
+
+void* operator new(size_t size) { return ThrowIfNull(Allocate(size)); }
+void* operator new[](size_t size) { return ThrowIfNull(Allocate(size)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return Allocate(size); }
+
+void operator delete(void* pMemory) noexcept { Deallocate(pMemory); }
+void operator delete[](void* pMemory) noexcept { Deallocate(pMemory); }
+void operator delete(void* pMemory, size_t) noexcept { Deallocate(pMemory); }
+void operator delete[](void* pMemory, size_t) noexcept { Deallocate(pMemory); }
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept { Deallocate(pMemory); }
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept { Deallocate(pMemory); }
+
+void* operator new(size_t size, std::align_val_t alignment) { return ThrowIfNull(AllocateAligned(size, alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return ThrowIfNull(AllocateAligned(size, alignment)); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return AllocateAligned(size, alignment); }
+
+void operator delete(void* pMemory, std::align_val_t) noexcept { DeallocateAligned(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t) noexcept { DeallocateAligned(pMemory); }
+void operator delete(void* pMemory, size_t, std::align_val_t) noexcept { DeallocateAligned(pMemory); }
+void operator delete[](void* pMemory, size_t, std::align_val_t) noexcept { DeallocateAligned(pMemory); }
+void operator delete(void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept { DeallocateAligned(pMemory); }
+void operator delete[](void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept { DeallocateAligned(pMemory); }
+
 bool Tests::testDotResult(Vector3 v1, Vector3 v2, float result)
 {
     float calculatedResult = Vector3::Dot(v1, v2);
@@ -24,6 +119,831 @@ bool Tests::testCrossResult(Vector3 v1, Vector3 v2, Vector3 result)
     return false;
 }
 
+// Every pixel of every frame goes through the tracing, shading and adaptive sampling stages, a frame must not heap allocate.
+bool Tests::testRenderDoesNotAllocate()
+{
+    const int width{ 64 }, height{ 48 };
+
+    Scene_W4_ReferenceScene scene{};
+    Renderer renderer{ uint32_t(width), uint32_t(height) };
+    scene.Initialize();
+    renderer.ToggleAdaptiveSampling();
+
+    // The first frame in every mode builds the acceleration structures and sizes the buffers, the second one is counted
+    const auto countAllocations = [&]() {
+        renderer.Render(&scene);
+        const size_t allocationsBefore = s_NrAllocations.load();
+        renderer.Render(&scene);
+        return s_NrAllocations.load() - allocationsBefore;
+    };
+
+    if (countAllocations() != 0)
+        return false;
+
+    // Single rays instead of packets
+    renderer.TogglePacketTracing();
+    if (countAllocations() != 0)
+        return false;
+
+    // A frame with more high contrast pixels than any frame before it, here the full view after a narrow one, does not allocate either
+    Renderer narrowFirst{ uint32_t(width), uint32_t(height) };
+    narrowFirst.ToggleAdaptiveSampling();
+    Camera& camera{ scene.GetCamera() };
+    const float fovAngle{ camera.fovAngle };
+    camera.fovAngle = 1.f;
+    narrowFirst.Render(&scene);
+    const uint32_t nrNarrowAdaptivePixels{ narrowFirst.GetNrAdaptivePixels() };
+    camera.fovAngle = fovAngle;
+    const size_t allocationsBefore = s_NrAllocations.load();
+    narrowFirst.Render(&scene);
+    return s_NrAllocations.load() == allocationsBefore && narrowFirst.GetNrAdaptivePixels() > nrNarrowAdaptivePixels;
+}
+
+// A packet must find the same closest hits as tracing its rays one by one.
+bool Tests::testPacketsMatchSingleRays()
+{
+    const int width{ 64 }, height{ 48 };
+
+    Scene_W4_ReferenceScene scene{};
+    Renderer renderer{ uint32_t(width), uint32_t(height) };
+    scene.Initialize();
+    renderer.Render(&scene);
+
+    Camera& camera = scene.GetCamera();
+    const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+    const float aspectRatio = width / static_cast<float>(height);
+    const float fov = tan(camera.fovAngle * TO_RADIANS / 2.f);
+
+    for (int py{}; py < height; py += RayPacket::Height) {
+        for (int px{}; px < width; px += RayPacket::Width) {
+            RayPacket packet{};
+            packet.origin = camera.origin;
+            for (uint32_t lane{}; lane < RayPacket::Size; ++lane) {
+                const float cx{ (2 * ((px + lane % RayPacket::Width + 0.5f) / float(width)) - 1) * aspectRatio * fov };
+                const float cy{ (1 - (2 * ((py + lane / RayPacket::Width + 0.5f) / float(height)))) * fov };
+                const Vector3 direction = cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized();
+                packet.directionX[lane] = direction.x;
+                packet.directionY[lane] = direction.y;
+                packet.directionZ[lane] = direction.z;
+            }
+            // Leave a lane out now and then to test partial packets
+            packet.laneMask = (1u << RayPacket::Size) - 1;
+            if (px % 3 == 0)
+                packet.laneMask &= ~1u;
+
+            HitRecord packetHits[RayPacket::Size]{};
+            scene.GetClosestHits(packet, packetHits);
+
+            for (uint32_t lane{}; lane < RayPacket::Size; ++lane) {
+                HitRecord singleHit{};
+                if (packet.laneMask & (1u << lane))
+                    scene.GetClosestHit(packet.GetRay(lane), singleHit);
+
+                if (packetHits[lane].didHit != singleHit.didHit || packetHits[lane].t != singleHit.t
+                    || packetHits[lane].materialIndex != singleHit.materialIndex)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// The shadow ray query must agree with the generic any-hit query on every ray, with and without the occluder cache.
+bool Tests::testOcclusionMatchesDoesHit()
+{
+    const int width{ 64 }, height{ 48 };
+
+    Scene_W4_ReferenceScene scene{};
+    Renderer renderer{ uint32_t(width), uint32_t(height) };
+    scene.Initialize();
+    renderer.Render(&scene);
+
+    Camera& camera = scene.GetCamera();
+    const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+    const float aspectRatio = width / static_cast<float>(height);
+    const float fov = tan(camera.fovAngle * TO_RADIANS / 2.f);
+
+    ShadowCache shadowCache{};
+    for (int py{}; py < height; ++py) {
+        for (int px{}; px < width; ++px) {
+            const float cx{ (2 * ((px + 0.5f) / float(width)) - 1) * aspectRatio * fov };
+            const float cy{ (1 - (2 * ((py + 0.5f) / float(height)))) * fov };
+            const Ray ray{ camera.origin, cameraToWorld.TransformVector({ cx, cy, 1 }).Normalized() };
+
+            // The camera ray itself, then the shadow rays from what it hits
+            if (scene.IsOccluded(ray) != scene.DoesHit(ray))
+                return false;
+
+            HitRecord hit{};
+            scene.GetClosestHit(ray, hit);
+            if (!hit.didHit)
+                continue;
+
+            for (size_t lightIndex{}; lightIndex < scene.GetLights().size(); ++lightIndex) {
+                const Ray lightRay = scene.GetLights()[lightIndex].CreateLightRay(hit.origin);
+                const bool doesHit = scene.DoesHit(lightRay);
+                if (scene.IsOccluded(lightRay) != doesHit || scene.IsOccluded(lightRay, &shadowCache, lightIndex) != doesHit)
+                    return false;
+            }
+        }
+    }
+
+    // The reference scene has shadows, so the cache must have been used
+    return shadowCache.nrHits > 0;
+}
+
+namespace
+{
+    // A small scene with a reference image of its regular render, and a second renderer whose settings a test changes.
+    // The comparisons hold the second renderer's image against the reference.
+    template<typename SceneType>
+    class ReferenceComparison final
+    {
+    public:
+        static constexpr uint32_t Width{ 64 }, Height{ 48 }, NrPixels{ Width * Height };
+
+        template<typename... Args>
+        explicit ReferenceComparison(Args&&... args) : m_Scene{ std::forward<Args>(args)... }
+        {
+            m_Scene.Initialize();
+            m_Reference.Render(&m_Scene);
+        }
+
+        SceneType& GetScene() { return m_Scene; }
+        Renderer& GetRenderer() { return m_Renderer; }
+        uint32_t GetReferencePixel(uint32_t pixelIndex) const { return m_Reference.GetBufferPixels()[pixelIndex]; }
+
+        bool Matches() const { return CountDifferentPixels() == 0; }
+
+        // Pixels with a colour channel more than the tolerance away from the reference
+        uint32_t CountDifferentPixels(int tolerance = 0) const
+        {
+            uint32_t nrDifferentPixels{};
+            for (uint32_t pixelIndex{}; pixelIndex < NrPixels; ++pixelIndex) {
+                for (int shift{}; shift < 24; shift += 8) {
+                    if (GetChannelDifference(pixelIndex, shift) > tolerance) {
+                        ++nrDifferentPixels;
+                        break;
+                    }
+                }
+            }
+            return nrDifferentPixels;
+        }
+
+        uint64_t SumChannelDifferences() const
+        {
+            uint64_t totalDifference{};
+            for (uint32_t pixelIndex{}; pixelIndex < NrPixels; ++pixelIndex) {
+                for (int shift{}; shift < 24; shift += 8)
+                    totalDifference += GetChannelDifference(pixelIndex, shift);
+            }
+            return totalDifference;
+        }
+
+    private:
+        SceneType m_Scene;
+        Renderer m_Reference{ Width, Height };
+        Renderer m_Renderer{ Width, Height };
+
+        int GetChannelDifference(uint32_t pixelIndex, int shift) const
+        {
+            const int channel{ int(m_Renderer.GetBufferPixels()[pixelIndex] >> shift & 0xFF) };
+            const int referenceChannel{ int(m_Reference.GetBufferPixels()[pixelIndex] >> shift & 0xFF) };
+            return std::abs(channel - referenceChannel);
+        }
+    };
+}
+
+// Switching the lighting mode only re-runs the shading stage, it must give the image a full render gives.
+bool Tests::testReshadeMatchesRender()
+{
+    const int width{ 64 }, height{ 48 };
+
+    Scene_W4_ReferenceScene scene{};
+    Renderer renderer{ uint32_t(width), uint32_t(height) };
+    scene.Initialize();
+    renderer.Render(&scene);
+
+    for (int mode{}; mode < 4; ++mode) {
+        renderer.m_colorManager.CycleLightingMode();
+        renderer.Shade(&scene);
+        const std::vector<uint32_t> reshaded(renderer.GetBufferPixels(), renderer.GetBufferPixels() + width * height);
+
+        renderer.Render(&scene);
+        if (!std::equal(reshaded.begin(), reshaded.end(), renderer.GetBufferPixels()))
+            return false;
+    }
+    const std::vector<uint32_t> rendered(renderer.GetBufferPixels(), renderer.GetBufferPixels() + width * height);
+
+    // A progressive image restarts from the reshaded last sample, reshading it again changes nothing
+    renderer.ToggleProgressive();
+    for (int frame{}; frame < 4; ++frame)
+        renderer.Render(&scene);
+    renderer.Shade(&scene);
+    const std::vector<uint32_t> reshaded(renderer.GetBufferPixels(), renderer.GetBufferPixels() + width * height);
+    renderer.Shade(&scene);
+    if (renderer.GetNrAccumulatedFrames() != 0 || !std::equal(reshaded.begin(), reshaded.end(), renderer.GetBufferPixels()))
+        return false;
+
+    // The next frame starts the accumulation over with a sample through the pixel centres
+    renderer.Render(&scene);
+    return std::equal(rendered.begin(), rendered.end(), renderer.GetBufferPixels());
+}
+
+bool Tests::testProgressiveAccumulation()
+{
+    ReferenceComparison<Scene_W3> comparison{};
+    Scene_W3& scene{ comparison.GetScene() };
+    Renderer& renderer{ comparison.GetRenderer() };
+
+    // The first sample goes through the pixel centres, just like a regular frame
+    renderer.ToggleProgressive();
+    renderer.Render(&scene);
+    if (!comparison.Matches())
+        return false;
+
+    // Jittered samples smooth the edges of the spheres
+    for (int frame{}; frame < 3; ++frame)
+        renderer.Render(&scene);
+    if (renderer.GetNrAccumulatedFrames() != 4 || comparison.Matches())
+        return false;
+
+    // Converged images are not rendered again
+    for (int frame{}; frame < 100; ++frame)
+        renderer.Render(&scene);
+    const uint32_t nrConvergedFrames{ renderer.GetNrAccumulatedFrames() };
+    if (nrConvergedFrames >= 100)
+        return false;
+    renderer.Render(&scene);
+    if (renderer.GetNrAccumulatedFrames() != nrConvergedFrames)
+        return false;
+
+    renderer.ResetAccumulation();
+    renderer.Render(&scene);
+    return comparison.Matches();
+}
+
+bool Tests::testAdaptiveSampling()
+{
+    ReferenceComparison<Scene_W4_ReferenceScene> comparison{};
+    Renderer& renderer{ comparison.GetRenderer() };
+
+    // Edges get refined, but never more pixels than the budget pays for
+    renderer.ToggleAdaptiveSampling();
+    renderer.SetAdaptiveRayBudget(0.2f);
+    renderer.Render(&comparison.GetScene());
+
+    const uint32_t nrChangedPixels{ comparison.CountDifferentPixels() };
+    const uint32_t nrAdaptivePixels{ renderer.GetNrAdaptivePixels() };
+    if (nrChangedPixels == 0 || nrAdaptivePixels == 0 || nrAdaptivePixels > comparison.NrPixels / 20)
+        return false;
+    if (nrChangedPixels > nrAdaptivePixels)
+        return false;
+
+    renderer.ToggleAdaptiveSampling();
+    renderer.Render(&comparison.GetScene());
+    return comparison.Matches();
+}
+
+bool Tests::testDynamicResolution()
+{
+    // Frames twice as slow as the target halve the pixels, a still view renders all of them
+    DynamicResolution dynamicResolution{ 0.05f };
+    float scale{};
+    for (int frame{}; frame < 5; ++frame)
+        scale = dynamicResolution.Update(0.1f, true);
+    if (scale < 0.65f || scale > 0.75f)
+        return false;
+    if (dynamicResolution.Update(0.1f, false) != 1.f || dynamicResolution.Update(0.2f, true) != scale)
+        return false;
+
+    ReferenceComparison<Scene_W4_ReferenceScene> comparison{};
+    Renderer& renderer{ comparison.GetRenderer() };
+
+    // Upscaled from half the resolution, the image stays close to the full one
+    renderer.SetRenderScale(0.5f);
+    renderer.Render(&comparison.GetScene());
+    if (renderer.GetRenderWidth() != comparison.Width / 2 || renderer.GetRenderHeight() != comparison.Height / 2)
+        return false;
+    if (comparison.SumChannelDifferences() > comparison.NrPixels * 3 * 8)
+        return false;
+
+    // Nothing to reshade until a frame was traced at the new scale
+    const std::vector<uint32_t> upscaled(renderer.GetBufferPixels(), renderer.GetBufferPixels() + comparison.NrPixels);
+    renderer.SetRenderScale(1.f);
+    renderer.Shade(&comparison.GetScene());
+    if (!std::equal(upscaled.begin(), upscaled.end(), renderer.GetBufferPixels()))
+        return false;
+
+    renderer.Render(&comparison.GetScene());
+    return comparison.Matches();
+}
+
+bool Tests::testRefinementMatchesRender()
+{
+    ReferenceComparison<Scene_W4_ReferenceScene> comparison{};
+    const uint32_t width{ comparison.Width };
+
+    // The finest level traces every pixel once, ending on the same image and the same G-buffer
+    Renderer& renderer{ comparison.GetRenderer() };
+    if (!renderer.RenderRefining(&comparison.GetScene()) || !comparison.Matches())
+        return false;
+    renderer.Shade(&comparison.GetScene());
+    if (!comparison.Matches())
+        return false;
+
+    // Cancelled after the first level (one check per row of 16 pixel tiles), every 8x8 block shows its corner pixel.
+    // A full frame goes first, so the cancelled refinement leaves a G-buffer with parts of two frames behind.
+    int nrChecks{};
+    Renderer cancelled{ comparison.Width, comparison.Height };
+    cancelled.Render(&comparison.GetScene());
+    if (cancelled.RenderRefining(&comparison.GetScene(), [&nrChecks, &comparison]() { return ++nrChecks > int(comparison.Height / 16); }))
+        return false;
+
+    for (uint32_t pixelIndex{}; pixelIndex < comparison.NrPixels; ++pixelIndex) {
+        const uint32_t px{ pixelIndex % width }, py{ pixelIndex / width };
+        if (cancelled.GetBufferPixels()[pixelIndex] != comparison.GetReferencePixel(px / 8 * 8 + py / 8 * 8 * width))
+            return false;
+    }
+
+    // Reshading a cancelled frame would mix it with the previous one, the preview stays as it is
+    const std::vector<uint32_t> preview(cancelled.GetBufferPixels(), cancelled.GetBufferPixels() + comparison.NrPixels);
+    cancelled.Shade(&comparison.GetScene());
+    return std::equal(preview.begin(), preview.end(), cancelled.GetBufferPixels());
+}
+
+bool Tests::testPipelineMatchesSequential()
+{
+    const int width{ 64 }, height{ 48 }, nrFrames{ 4 };
+    const uint32_t nrPixels{ uint32_t(width * height) };
+    constexpr float frameTime{ 1.f / 30.f };
+
+    // Reference: update and render one after the other on a single animated scene
+    std::vector<std::vector<uint32_t>> frames{};
+    {
+        Scene_W4 scene{};
+        scene.Initialize();
+        Renderer renderer{ uint32_t(width), uint32_t(height) };
+        Timer timer{};
+        for (int frame{}; frame < nrFrames; ++frame) {
+            scene.Update(&timer);
+            renderer.Render(&scene);
+            frames.emplace_back(renderer.GetBufferPixels(), renderer.GetBufferPixels() + nrPixels);
+            timer.UpdateFixed(frameTime);
+        }
+    }
+
+    // Pipelined: the double-buffered scenes alternate, every frame has to come out the same
+    Scene_W4 scene{}, backScene{};
+    scene.Initialize();
+    backScene.Initialize();
+    Renderer renderer{ uint32_t(width), uint32_t(height) };
+    Timer timer{};
+    FramePipeline pipeline{ &renderer, &scene, &backScene };
+
+    int nrFinishedFrames{};
+    for (int frame{}; frame <= nrFrames; ++frame) {
+        if (frame < nrFrames) {
+            pipeline.GetBackScene()->Update(&timer);
+            timer.UpdateFixed(frameTime);
+        }
+
+        if (pipeline.WaitForFrame()) {
+            const std::vector<uint32_t>& frontBuffer{ pipeline.GetFrontBuffer() };
+            if (!std::equal(frontBuffer.begin(), frontBuffer.end(), frames[nrFinishedFrames].begin()))
+                return false;
+            ++nrFinishedFrames;
+        }
+
+        if (frame < nrFrames)
+            pipeline.StartFrame();
+    }
+
+    return nrFinishedFrames == nrFrames;
+}
+
+bool Tests::testLoadOBJ()
+{
+    const auto load = [](const char* contents, TriangleMesh& mesh, ThreadPool* pThreadPool = nullptr) {
+        const char* filename{ "test_load.obj" };
+        std::ofstream(filename, std::ios::binary) << contents;
+        const bool isLoaded{ Utils::LoadOBJ(filename, mesh, pThreadPool) };
+        std::remove(filename);
+        return isLoaded;
+    };
+    const auto isEqual = [](const Vector3& v1, const Vector3& v2) {
+        return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
+    };
+
+    // A quad with vertex normals, relative indices, CRLF line ends and an exponent
+    TriangleMesh mesh{};
+    const char* contents{
+        "# comment\n"
+        "o Quad\n"
+        "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+        "vt 0 0\n"
+        "vn 0 0 -1\n"
+        "f 1/1/1 2/1/1 3/1/1 4/1/1\n"
+        "v 0 0 1\r\nv 1 0 1\r\nv 1e0 1 +1.0\r\n"
+        "f -3 -2 -1\r\n"
+        "f 5//-1 6//1 7//1"
+    };
+    if (!load(contents, mesh) || mesh.positions.size() != 7)
+        return false;
+
+    const std::vector<int> indices{ 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 5, 6 };
+    if (mesh.indices != indices || mesh.normals.size() != 4 || mesh.positions[6].x != 1.f)
+        return false;
+    if (!isEqual(mesh.normals[0], -Vector3::UnitZ) || !isEqual(mesh.normals[1], -Vector3::UnitZ))
+        return false;
+    if (!isEqual(mesh.normals[2], Vector3::UnitZ) || !isEqual(mesh.normals[3], -Vector3::UnitZ))
+        return false;
+
+    // Malformed faces and out of range indices fail and leave the mesh alone
+    if (load("v 0 0 0\nv 1 0 0\nf 1 2\n", mesh) || load("v 0 0 0\nf 1 2 3\n", mesh) || load("f 1/1/1 -1 0\n", mesh))
+        return false;
+    if (mesh.indices != indices)
+        return false;
+
+    // Large enough to be split in chunks, with relative indices at every chunk boundary
+    std::string largeContents{};
+    const int nrTriangles{ 20000 };
+    for (int triangle{}; triangle < nrTriangles; ++triangle)
+        largeContents += "v " + std::to_string(triangle) + " 0 0\nv 0 1 0\nv 0 0 1\nf -3 -2 -1\n";
+
+    ThreadPool threadPool{ 4 };
+    if (!load(largeContents.c_str(), mesh, &threadPool) || mesh.indices.size() != nrTriangles * 3)
+        return false;
+    for (int index{}; index < nrTriangles * 3; ++index) {
+        if (mesh.indices[index] != index)
+            return false;
+    }
+
+    // Same mesh as the stream parser reads. ParseOBJ adds one stray face of index -1 when the file ends in a line break, it is left out.
+    std::vector<Vector3> positions{}, normals{};
+    std::vector<int> parsedIndices{};
+    if (!Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", positions, normals, parsedIndices))
+        return false;
+    if (!Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", mesh) || mesh.indices.size() + 3 != parsedIndices.size())
+        return false;
+    return std::equal(mesh.indices.begin(), mesh.indices.end(), parsedIndices.begin())
+        && std::equal(positions.begin(), positions.end(), mesh.positions.begin(), mesh.positions.end(), isEqual)
+        && std::equal(mesh.normals.begin(), mesh.normals.end(), normals.begin(), isEqual);
+}
+
+bool Tests::testMeshCache()
+{
+    const std::string filename{ "test_cache.obj" };
+    const std::string cacheFilename{ Utils::GetMeshCacheFilename(filename) };
+    std::remove(cacheFilename.c_str());
+
+    std::string contents{};
+    for (int quad{}; quad < 64; ++quad)
+        contents += "v " + std::to_string(quad) + " 0 0\nv " + std::to_string(quad) + " 1 0\nv " + std::to_string(quad) + " 1 1\nv 0 0 1\nf -4 -3 -2 -1\n";
+    std::ofstream(filename, std::ios::binary) << contents;
+
+    // The first load writes the cache, the second one reads it back
+    TriangleMesh parsedMesh{}, cachedMesh{};
+    if (!Utils::LoadOBJCached(filename, parsedMesh) || !Utils::LoadOBJCached(filename, cachedMesh) || !std::ifstream(cacheFilename))
+        return false;
+
+    const auto isEqual = [](const Vector3& v1, const Vector3& v2) {
+        return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
+    };
+    const auto isNodeEqual = [&isEqual](const BVHNode& node1, const BVHNode& node2) {
+        return isEqual(node1.minAABB, node2.minAABB) && isEqual(node1.maxAABB, node2.maxAABB)
+            && node1.leftFirst == node2.leftFirst && node1.primitiveCount == node2.primitiveCount;
+    };
+    const auto isBVHEqual = [&isNodeEqual](const BVH& bvh1, const BVH& bvh2) {
+        return bvh1.nodesUsed == bvh2.nodesUsed && bvh1.GetPrimitiveCount() == bvh2.GetPrimitiveCount()
+            && std::equal(bvh1.GetNodes(), bvh1.GetNodes() + bvh1.nodesUsed, bvh2.GetNodes(), isNodeEqual)
+            && std::equal(bvh1.GetPrimitiveIndices(), bvh1.GetPrimitiveIndices() + bvh1.GetPrimitiveCount(), bvh2.GetPrimitiveIndices());
+    };
+    bool isSame{ cachedMesh.indices == parsedMesh.indices && cachedMesh.bvh.IsMapped() && isBVHEqual(cachedMesh.bvh, parsedMesh.bvh) };
+    isSame &= std::equal(parsedMesh.positions.begin(), parsedMesh.positions.end(), cachedMesh.positions.begin(), cachedMesh.positions.end(), isEqual);
+    isSame &= std::equal(parsedMesh.normals.begin(), parsedMesh.normals.end(), cachedMesh.normals.begin(), cachedMesh.normals.end(), isEqual);
+
+    // Refitting copies the tree out of the mapping
+    parsedMesh.UpdateTransforms();
+    cachedMesh.UpdateTransforms();
+    isSame &= !cachedMesh.bvh.IsMapped() && isBVHEqual(cachedMesh.bvh, parsedMesh.bvh);
+
+    // Blocks whose nodes or primitive indices point outside of them are not attached
+    const std::string blockFilename{ "test_block.bvh" };
+    const auto attachesAfter = [&](const BVH& source, uint32_t nrPrimitives, const auto& corrupt) {
+        std::vector<char> block{};
+        source.Serialize(block);
+        const char* pNodes{ reinterpret_cast<const char*>(source.GetNodes()) };
+        const size_t nodesOffset{ size_t(std::search(block.begin(), block.end(), pNodes, pNodes + sizeof(BVHNode)) - block.begin()) };
+        corrupt(block.data() + nodesOffset, block.data() + nodesOffset + source.nodesUsed * sizeof(BVHNode));
+        std::ofstream(blockFilename, std::ios::binary).write(block.data(), block.size());
+
+        BVH bvh{ source.GetLeafWidth() };
+        return bvh.Attach(std::make_shared<const MappedFile>(blockFilename), 0, nrPrimitives);
+    };
+    const uint32_t nrTriangles{ parsedMesh.bvh.GetPrimitiveCount() };
+    const auto writeValue = [](char* pDestination, uint32_t value) { std::memcpy(pDestination, &value, sizeof(value)); };
+    isSame &= attachesAfter(parsedMesh.bvh, nrTriangles, [](char*, char*) {});
+    isSame &= !attachesAfter(parsedMesh.bvh, nrTriangles + 1, [](char*, char*) {});
+    isSame &= !attachesAfter(parsedMesh.bvh, nrTriangles, [&](char* pNodes, char*) { writeValue(pNodes + offsetof(BVHNode, leftFirst), parsedMesh.bvh.nodesUsed); });
+    isSame &= !attachesAfter(parsedMesh.bvh, nrTriangles, [&](char*, char* pPrimitiveIndices) { writeValue(pPrimitiveIndices, nrTriangles); });
+    // Every node the parent of the next two, a chain far deeper than the traversal stack holds
+    // Inner nodes down to the depth the builder stops at attach, one level deeper would overflow the traversal stack
+    const auto isDeepChainAttached = [&](uint32_t nrInnerLevels) {
+        BVH chain{ parsedMesh.bvh.GetLeafWidth() };
+        std::vector<BVHNode> nodes(2 * nrInnerLevels + 1);
+        for (uint32_t nodeIndex{}; nodeIndex < nodes.size(); ++nodeIndex) {
+            const bool isInner{ nodeIndex == 0 || (nodeIndex % 2 == 1 && nodeIndex + 2 < nodes.size()) };
+            nodes[nodeIndex].leftFirst = isInner ? (nodeIndex == 0 ? 1 : nodeIndex + 2) : 0;
+            nodes[nodeIndex].primitiveCount = isInner ? 0 : 1;
+        }
+        chain.Assign(std::move(nodes), { 0 });
+        return attachesAfter(chain, 1, [](char*, char*) {});
+    };
+    isSame &= isDeepChainAttached(BVH::MaxDepth) && !isDeepChainAttached(BVH::MaxDepth + 1);
+    std::remove(blockFilename.c_str());
+
+    // An edited OBJ no longer matches the cache
+    std::ofstream(filename, std::ios::binary | std::ios::app) << "f 1 2 3\n";
+    TriangleMesh editedMesh{};
+    const bool isReloaded{ Utils::LoadOBJCached(filename, editedMesh) && editedMesh.indices.size() == parsedMesh.indices.size() + 3 };
+
+    std::remove(filename.c_str());
+    std::remove(cacheFilename.c_str());
+    return isSame && isReloaded;
+}
+
+bool Tests::testParallelBuild()
+{
+    // A height field large enough for the builds to fan out over the pool
+    constexpr int nrColumns{ 100 };
+    TriangleMesh gridMesh{};
+    for (int row{}; row <= nrColumns; ++row)
+        for (int column{}; column <= nrColumns; ++column)
+            gridMesh.positions.push_back(Vector3{ float(column), sinf(column * 0.3f) * cosf(row * 0.2f), float(row) });
+    for (int row{}; row < nrColumns; ++row)
+    {
+        for (int column{}; column < nrColumns; ++column)
+        {
+            const int corner{ row * (nrColumns + 1) + column };
+            gridMesh.indices.insert(gridMesh.indices.end(), { corner, corner + nrColumns + 1, corner + 1 });
+            gridMesh.indices.insert(gridMesh.indices.end(), { corner + 1, corner + nrColumns + 1, corner + nrColumns + 2 });
+        }
+    }
+    gridMesh.CalculateNormals();
+
+    ThreadPool threadPool{ 4 };
+    const auto buildMesh = [&gridMesh](BVH::BuildMode buildMode, ThreadPool* pThreadPool) {
+        TriangleMesh mesh{ gridMesh };
+        mesh.bvh.SetBuildMode(buildMode);
+        mesh.bvh.SetThreadPool(pThreadPool);
+        mesh.UpdateTransforms();
+        return mesh;
+    };
+    const TriangleMesh sahMesh{ buildMesh(BVH::BuildMode::SAH, nullptr) };
+    const TriangleMesh sahParallelMesh{ buildMesh(BVH::BuildMode::SAH, &threadPool) };
+    const TriangleMesh mortonMesh{ buildMesh(BVH::BuildMode::Morton, nullptr) };
+    const TriangleMesh mortonParallelMesh{ buildMesh(BVH::BuildMode::Morton, &threadPool) };
+
+    const auto hasSameOrder = [](const BVH& bvh1, const BVH& bvh2) {
+        return bvh1.GetPrimitiveCount() == bvh2.GetPrimitiveCount()
+            && std::equal(bvh1.GetPrimitiveIndices(), bvh1.GetPrimitiveIndices() + bvh1.GetPrimitiveCount(), bvh2.GetPrimitiveIndices());
+    };
+
+    // Building the subtrees in parallel does not change the tree, only the order its nodes are stored in
+    const float sahCost{ sahMesh.bvh.CalculateCost() };
+    if (sahParallelMesh.bvh.nodesUsed != sahMesh.bvh.nodesUsed || !hasSameOrder(sahParallelMesh.bvh, sahMesh.bvh)
+        || std::abs(sahParallelMesh.bvh.CalculateCost() - sahCost) > 1e-4f * sahCost)
+        return false;
+    if (!hasSameOrder(mortonParallelMesh.bvh, mortonMesh.bvh))
+        return false;
+
+    // The Morton tree holds every triangle exactly once
+    std::vector<uint32_t> primitives(mortonMesh.bvh.GetPrimitiveIndices(), mortonMesh.bvh.GetPrimitiveIndices() + mortonMesh.bvh.GetPrimitiveCount());
+    std::sort(primitives.begin(), primitives.end());
+    for (uint32_t index{}; index < primitives.size(); ++index)
+        if (primitives[index] != index)
+            return false;
+    if (primitives.size() != gridMesh.indices.size() / 3)
+        return false;
+
+    // Every tree finds the same closest hits
+    std::mt19937 generator{ 1415 };
+    std::uniform_real_distribution<float> distribution{ 0.f, float(nrColumns) };
+    for (int rayIndex{}; rayIndex < 256; ++rayIndex)
+    {
+        const Ray ray{ Vector3{ distribution(generator), 5.f, distribution(generator) }, Vector3{ 0.f, -1.f, 0.f } };
+        HitRecord sahHit{}, sahParallelHit{}, mortonHit{}, mortonParallelHit{};
+        GeometryUtils::HitTest_TriangleMesh(sahMesh, ray, sahHit);
+        GeometryUtils::HitTest_TriangleMesh(sahParallelMesh, ray, sahParallelHit);
+        GeometryUtils::HitTest_TriangleMesh(mortonMesh, ray, mortonHit);
+        GeometryUtils::HitTest_TriangleMesh(mortonParallelMesh, ray, mortonParallelHit);
+        if (!sahHit.didHit || sahParallelHit.t != sahHit.t || mortonHit.t != sahHit.t || mortonParallelHit.t != sahHit.t)
+            return false;
+    }
+    return true;
+}
+
+bool Tests::testBVH8MatchesBVH()
+{
+    TriangleMesh bunny{};
+    if (!Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", bunny))
+        return false;
+    bunny.cullMode = TriangleCullMode::NoCulling;
+
+    // Coincident triangles the builder cannot split, their leaf is too large for one wide node
+    TriangleMesh coincident{};
+    coincident.cullMode = TriangleCullMode::NoCulling;
+    for (int triangle{}; triangle < 1000; ++triangle)
+        coincident.AppendTriangle(Triangle{ Vector3{ -1.f, 0.f, 0.f }, Vector3{ 1.f, 0.f, 0.f }, Vector3{ 0.f, 2.f, 0.f } }, true);
+
+    TriangleMesh instancedBunny{ bunny };
+    instancedBunny.isInstanced = true;
+    instancedBunny.RotateY(0.5f);
+    instancedBunny.Translate(Vector3{ 0.5f, 0.f, 0.f });
+
+    std::mt19937 generator{ 1617 };
+    std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+    for (const TriangleMesh* pSourceMesh : { &bunny, &coincident, &instancedBunny })
+    {
+        TriangleMesh binaryMesh{ *pSourceMesh }, wideMesh{ *pSourceMesh };
+        wideMesh.bvhLayout = BVHLayout::Wide8;
+        binaryMesh.UpdateTransforms();
+        wideMesh.UpdateTransforms();
+        // Every wide node stands in for several binary ones
+        if (wideMesh.bvh8.IsEmpty() || wideMesh.bvh8.nodes.size() * 4 > wideMesh.bvh.nodesUsed + 3)
+            return false;
+
+        // Rays from around the mesh towards random points in its bounds, about half of them hit
+        const Vector3 center{ (binaryMesh.minAABB + binaryMesh.maxAABB) * 0.5f };
+        const Vector3 extent{ binaryMesh.maxAABB - binaryMesh.minAABB + Vector3{ 1.f, 1.f, 1.f } };
+        for (int rayIndex{}; rayIndex < 1024; ++rayIndex)
+        {
+            const Vector3 origin{ center + 2.f * Vector3{ distribution(generator) * extent.x, distribution(generator) * extent.y, distribution(generator) * extent.z } };
+            const Vector3 target{ center + 0.5f * Vector3{ distribution(generator) * extent.x, distribution(generator) * extent.y, distribution(generator) * extent.z } };
+            const Ray ray{ origin, (target - origin).Normalized() };
+
+            HitRecord binaryHit{}, wideHit{};
+            GeometryUtils::HitTest_TriangleMesh(binaryMesh, ray, binaryHit);
+            GeometryUtils::HitTest_TriangleMesh(wideMesh, ray, wideHit);
+            if (binaryHit.didHit != wideHit.didHit || binaryHit.t != wideHit.t)
+                return false;
+            if (GeometryUtils::HitTest_TriangleMesh(wideMesh, ray) != binaryHit.didHit || GeometryUtils::Occludes_TriangleMesh(wideMesh, ray) != binaryHit.didHit)
+                return false;
+        }
+    }
+
+    // Switching a scene whose meshes are already built gives them their wide trees as well
+    ReferenceComparison<Scene_W4_ReferenceScene> comparison{};
+    Scene_W4_ReferenceScene wideScene{};
+    wideScene.Initialize();
+    wideScene.SetBVHLayout(BVHLayout::Wide8);
+    comparison.GetRenderer().Render(&wideScene);
+    return comparison.Matches();
+}
+
+namespace
+{
+    // A grid of rotated bunnies, instances of one shared mesh or copies with their own transformed vertices.
+    // More meshes than fit the storage the scene starts out with, so adding them moves memory around.
+    class InstancingTestScene final : public Scene
+    {
+    public:
+        explicit InstancingTestScene(bool isInstanced) : m_IsInstanced{ isInstanced } {}
+
+        void Initialize() override
+        {
+            m_Camera.origin = { 0.f, 2.f, -12.f };
+            m_Camera.fovAngle = 45.f;
+
+            const auto matLambert_White = AddMaterial(Material::Lambert(colors::White, 1.f));
+            AddPlane(Vector3{ 0.f, 0.f, 0.f }, Vector3{ 0.f, 1.f, 0.f }, AddMaterial(Material::Lambert({ .49f, 0.57f, 0.57f }, 1.f)));
+            AddPointLight(Vector3{ -2.5f, 5.f, -5.f }, 70.f, ColorRGB{ 1.f, .8f, .45f });
+
+            const TriangleMesh* pSource{ nullptr };
+            for (int meshIndex{}; meshIndex < 40; ++meshIndex)
+            {
+                TriangleMesh* pMesh{ nullptr };
+                if (m_IsInstanced && pSource)
+                {
+                    pMesh = AddTriangleMeshInstance(pSource, TriangleCullMode::BackFaceCulling, matLambert_White);
+                }
+                else
+                {
+                    pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+                    pMesh->isInstanced = m_IsInstanced;
+                    Utils::LoadOBJ("Resources/lowpoly_bunny2.obj", *pMesh);
+                    pSource = pMesh;
+                }
+
+                pMesh->Scale({ .4f, .4f, .4f });
+                pMesh->RotateY(meshIndex * 20.f);
+                pMesh->Translate({ (meshIndex % 8 - 3.5f) * 1.2f, (meshIndex / 8) * 1.f, 0.f });
+                pMesh->UpdateTransforms();
+            }
+        }
+
+    private:
+        bool m_IsInstanced;
+    };
+}
+
+// Instances trace in object space, copies in world space: apart from rounding both show the same image
+bool Tests::testInstancesMatchCopies()
+{
+    ReferenceComparison<InstancingTestScene> comparison{ false };
+
+    InstancingTestScene instancedScene{ true };
+    instancedScene.Initialize();
+    comparison.GetRenderer().Render(&instancedScene);
+
+    return comparison.CountDifferentPixels(2) <= comparison.NrPixels / 100;
+}
+
+// The SAH BVH replaced a loop over all triangles of a mesh, built or refitted it has to find the same closest and any hits
+bool Tests::testMeshBVHMatchesBruteForce()
+{
+    constexpr int nrColumns{ 16 };
+    TriangleMesh mesh{};
+    mesh.cullMode = TriangleCullMode::NoCulling;
+    for (int row{}; row <= nrColumns; ++row)
+        for (int column{}; column <= nrColumns; ++column)
+            mesh.positions.push_back(Vector3{ float(column), 0.f, float(row) });
+    for (int row{}; row < nrColumns; ++row)
+    {
+        for (int column{}; column < nrColumns; ++column)
+        {
+            const int corner{ row * (nrColumns + 1) + column };
+            mesh.indices.insert(mesh.indices.end(), { corner, corner + nrColumns + 1, corner + 1 });
+            mesh.indices.insert(mesh.indices.end(), { corner + 1, corner + nrColumns + 1, corner + nrColumns + 2 });
+        }
+    }
+
+    std::mt19937 generator{ 1617 };
+    std::uniform_real_distribution<float> distribution{ -1.f, 1.f };
+    const auto deform = [&mesh](const auto& calculatePosition) {
+        for (size_t vertexIndex{}; vertexIndex < mesh.positions.size(); ++vertexIndex)
+            mesh.positions[vertexIndex] = calculatePosition(int(vertexIndex % (nrColumns + 1)), int(vertexIndex / (nrColumns + 1)));
+        // CalculateNormals appends to the normals
+        mesh.normals.clear();
+        mesh.CalculateNormals();
+        mesh.UpdateTransforms();
+    };
+    const auto matchesBruteForce = [&]() {
+        const Vector3 center{ (mesh.minAABB + mesh.maxAABB) * 0.5f };
+        const Vector3 extent{ mesh.maxAABB - mesh.minAABB + Vector3{ 1.f, 1.f, 1.f } };
+        for (int rayIndex{}; rayIndex < 512; ++rayIndex)
+        {
+            const Vector3 origin{ center + 2.f * Vector3{ distribution(generator) * extent.x, distribution(generator) * extent.y, distribution(generator) * extent.z } };
+            const Vector3 target{ center + 0.5f * Vector3{ distribution(generator) * extent.x, distribution(generator) * extent.y, distribution(generator) * extent.z } };
+            const Ray ray{ origin, (target - origin).Normalized() };
+
+            HitRecord bvhHit{}, bruteForceHit{};
+            GeometryUtils::HitTest_TriangleMesh(mesh, ray, bvhHit);
+            for (size_t index{}; index < mesh.indices.size(); index += 3)
+            {
+                Triangle triangle{ mesh.transformedPositions[mesh.indices[index]], mesh.transformedPositions[mesh.indices[index + 1]], mesh.transformedPositions[mesh.indices[index + 2]] };
+                triangle.cullMode = mesh.cullMode;
+                GeometryUtils::HitTest_Triangle(triangle, ray, bruteForceHit);
+            }
+            if (bvhHit.didHit != bruteForceHit.didHit || (bvhHit.didHit && std::abs(bvhHit.t - bruteForceHit.t) > 1e-4f * bruteForceHit.t))
+                return false;
+            if (GeometryUtils::HitTest_TriangleMesh(mesh, ray) != bruteForceHit.didHit || GeometryUtils::Occludes_TriangleMesh(mesh, ray) != bruteForceHit.didHit)
+                return false;
+        }
+        return true;
+    };
+    const auto getPrimitiveOrder = [&mesh]() {
+        return std::vector<uint32_t>(mesh.bvh.GetPrimitiveIndices(), mesh.bvh.GetPrimitiveIndices() + mesh.bvh.GetPrimitiveCount());
+    };
+
+    const auto wave = [](float phase) {
+        return [phase](int column, int row) { return Vector3{ float(column), sinf(column * 0.5f + phase) * cosf(row * 0.4f), float(row) }; };
+    };
+    // Straight after the SAH build
+    deform(wave(0.f));
+    if (mesh.bvh.GetBuildMode() != BVH::BuildMode::SAH || !matchesBruteForce())
+        return false;
+    const std::vector<uint32_t> builtOrder{ getPrimitiveOrder() };
+
+    // A rolling wave only refits, the tree keeps the order it was built with
+    for (int frame{ 1 }; frame <= 4; ++frame)
+    {
+        deform(wave(frame * 0.5f));
+        if (getPrimitiveOrder() != builtOrder || !matchesBruteForce())
+            return false;
+    }
+
+    // Vertices scattered through the volume leave a refitted tree far worse than a new one, so the mesh rebuilds
+    deform([&](int, int) { return Vector3{ distribution(generator), distribution(generator), distribution(generator) } * float(nrColumns); });
+    BVH rebuilt{ mesh.bvh.GetLeafWidth() };
+    rebuilt.Build(mesh.transformedPositions, mesh.indices);
+    if (getPrimitiveOrder() == builtOrder || getPrimitiveOrder() != std::vector<uint32_t>(rebuilt.GetPrimitiveIndices(), rebuilt.GetPrimitiveIndices() + rebuilt.GetPrimitiveCount()))
+        return false;
+    return matchesBruteForce();
+}
+
 int Tests::runTests()
 {
     if (!testDotResult(Vector3::UnitX, Vector3::UnitX, 1))      return 1;
@@ -33,5 +953,35 @@ int Tests::runTests()
     if (!testCrossResult(Vector3::UnitZ, Vector3::UnitX, Vector3::UnitY))     return 2;
     if (!testCrossResult(Vector3::UnitX, Vector3::UnitZ, -Vector3::UnitY))    return 2;
 
+    if (!testRenderDoesNotAllocate())    return 3;
+
+    if (!testPacketsMatchSingleRays())    return 4;
+
+    if (!testOcclusionMatchesDoesHit())    return 5;
+
+    if (!testReshadeMatchesRender())    return 6;
+
+    if (!testProgressiveAccumulation())    return 7;
+
+    if (!testAdaptiveSampling())    return 8;
+
+    if (!testDynamicResolution())    return 9;
+
+    if (!testRefinementMatchesRender())    return 10;
+
+    if (!testPipelineMatchesSequential())    return 11;
+
+    if (!testLoadOBJ())    return 12;
+
+    if (!testMeshCache())    return 13;
+
+    if (!testParallelBuild())    return 14;
+
+    if (!testBVH8MatchesBVH())    return 15;
+
+    if (!testInstancesMatchCopies())    return 16;
+
+    if (!testMeshBVHMatchesBruteForce())    return 17;
+
     return 0;
 }
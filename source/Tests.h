@@ -1,4 +1,6 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
 #include "Vector3.h"
 
 using namespace dae;
@@ -8,8 +10,26 @@ class Tests
 	private:
 		bool static testDotResult(Vector3 v1, Vector3 v2, float result);
 		bool static testCrossResult(Vector3 v1, Vector3 v2, Vector3 result);
+		bool static testRenderDoesNotAllocate();
+		bool static testPacketsMatchSingleRays();
+		bool static testOcclusionMatchesDoesHit();
+		bool static testReshadeMatchesRender();
+		bool static testProgressiveAccumulation();
+		bool static testAdaptiveSampling();
+		bool static testDynamicResolution();
+		bool static testRefinementMatchesRender();
+		bool static testPipelineMatchesSequential();
+		bool static testLoadOBJ();
+		bool static testMeshCache();
+		bool static testParallelBuild();
+		bool static testBVH8MatchesBVH();
+		bool static testInstancesMatchCopies();
+		bool static testMeshBVHMatchesBruteForce();
 
 	public:
 		int static runTests();
+
+		// Counts every global operator new, Tests.cpp replaces the allocation functions of the test executable.
+		static std::atomic<size_t> s_NrAllocations;
 };
 
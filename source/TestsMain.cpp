@@ -0,0 +1,16 @@
+//Entry point of the test executable, returns the code of the first failing test group or 0.
+
+//Standard includes
+#include <iostream>
+
+//Project includes
+#include "Tests.h"
+
+int main()
+{
+	const int result{ Tests::runTests() };
+	if (result != 0)
+		std::cerr << "Test group " << result << " failed." << std::endl;
+
+	return result;
+}
@@ -0,0 +1,148 @@
+#include "ThreadPool.h"
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t nrThreads)
+{
+	// hardware_concurrency is allowed to report 0
+	if (nrThreads == 0)
+		nrThreads = 1;
+
+	m_Queues.reserve(nrThreads);
+	for (uint32_t i = 0; i < nrThreads; ++i)
+		m_Queues.emplace_back(std::make_unique<WorkerQueue>());
+
+	// Queue 0 belongs to the thread calling ParallelFor
+	m_Workers.reserve(nrThreads - 1);
+	for (uint32_t i = 1; i < nrThreads; ++i)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WakeCondition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+void ThreadPool::ParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& job)
+{
+	if (nrTasks == 0)
+		return;
+
+	bool isBusy{ false };
+	if (!m_IsBusy.compare_exchange_strong(isBusy, true)) {
+		for (uint32_t task = 0; task < nrTasks; ++task)
+			job(task);
+		return;
+	}
+
+	m_pJob = &job;
+	m_RemainingTasks.store(nrTasks);
+
+	// Hand every worker a contiguous range, so neighbouring tasks (tiles) stay on the same thread until stolen.
+	const uint32_t nrQueues = GetNrThreads();
+	for (uint32_t q = 0; q < nrQueues; ++q)
+	{
+		const uint32_t first = static_cast<uint32_t>(uint64_t(nrTasks) * q / nrQueues);
+		const uint32_t last = static_cast<uint32_t>(uint64_t(nrTasks) * (q + 1) / nrQueues);
+
+		WorkerQueue& queue = *m_Queues[q];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.clear();
+		queue.head = 0;
+		for (uint32_t task = first; task < last; ++task)
+			queue.tasks.push_back(task);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Generation;
+	}
+	m_WakeCondition.notify_all();
+
+	ExecuteTasks(0);
+
+	// Wait for the workers to leave the job as well, they must not touch it once we return.
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_DoneCondition.wait(lock, [this] { return m_BusyWorkers == 0 && m_RemainingTasks.load() == 0; });
+	m_pJob = nullptr;
+	m_IsBusy.store(false);
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_WakeCondition.wait(lock, [&] { return m_Quit || m_Generation != seenGeneration; });
+			if (m_Quit)
+				return;
+
+			seenGeneration = m_Generation;
+			++m_BusyWorkers;
+		}
+
+		ExecuteTasks(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			--m_BusyWorkers;
+		}
+		m_DoneCondition.notify_all();
+	}
+}
+
+void ThreadPool::ExecuteTasks(uint32_t workerIndex)
+{
+	while (m_RemainingTasks.load() > 0)
+	{
+		uint32_t task{};
+		if (!PopTask(workerIndex, task) && !StealTask(workerIndex, task))
+		{
+			// Nothing left to take, the last tasks are still running on other threads
+			std::this_thread::yield();
+			continue;
+		}
+
+		(*m_pJob)(task);
+		m_RemainingTasks.fetch_sub(1);
+	}
+}
+
+bool ThreadPool::PopTask(uint32_t workerIndex, uint32_t& task)
+{
+	WorkerQueue& queue = *m_Queues[workerIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.IsEmpty())
+		return false;
+
+	task = queue.tasks[queue.head++];
+	return true;
+}
+
+bool ThreadPool::StealTask(uint32_t workerIndex, uint32_t& task)
+{
+	// Steal from the back, the end of the victim's range that it would reach last
+	const uint32_t nrQueues = GetNrThreads();
+	for (uint32_t offset = 1; offset < nrQueues; ++offset)
+	{
+		WorkerQueue& victim = *m_Queues[(workerIndex + offset) % nrQueues];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.IsEmpty())
+			continue;
+
+		task = victim.tasks.back();
+		victim.tasks.pop_back();
+		return true;
+	}
+
+	return false;
+}
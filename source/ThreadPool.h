@@ -0,0 +1,69 @@
+#pragma once
+
+//Standard includes
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// Persistent pool of worker threads. Every worker owns a deque of task indices and steals from the others once its own runs dry.
+	class ThreadPool final
+	{
+	public:
+		ThreadPool(uint32_t nrThreads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// Calls job(taskIndex) for every index in [0, nrTasks) and returns once all of them finished.
+		// The calling thread works along, so a pool of n threads keeps n - 1 workers of its own.
+		// The workers run one job at a time: a call made while they are busy, from another thread or from a task,
+		// runs all of its tasks on the calling thread instead of waiting.
+		void ParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& job);
+		// Lambdas are passed on by reference: a std::function copy of a lambda with more captures than its small buffer holds would allocate every call.
+		template<typename Job>
+		void ParallelFor(uint32_t nrTasks, const Job& job) { ParallelFor(nrTasks, std::function<void(uint32_t)>{ std::cref(job) }); }
+
+		uint32_t GetNrThreads() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	private:
+		// Double ended queue over a vector that keeps its capacity, so refilling it every frame does not allocate.
+		// The owner pops at the front (head), thieves pop at the back.
+		struct WorkerQueue
+		{
+			std::mutex mutex{};
+			std::vector<uint32_t> tasks{};
+			size_t head{};
+
+			bool IsEmpty() const { return head == tasks.size(); }
+		};
+
+		std::vector<std::thread> m_Workers{};
+		std::vector<std::unique_ptr<WorkerQueue>> m_Queues{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+		uint64_t m_Generation{};
+		uint32_t m_BusyWorkers{};
+		bool m_Quit{ false };
+
+		const std::function<void(uint32_t)>* m_pJob{};
+		std::atomic<uint32_t> m_RemainingTasks{};
+		std::atomic<bool> m_IsBusy{ false };
+
+		void WorkerLoop(uint32_t workerIndex);
+		void ExecuteTasks(uint32_t workerIndex);
+		bool PopTask(uint32_t workerIndex, uint32_t& task);
+		bool StealTask(uint32_t workerIndex, uint32_t& task);
+	};
+}
@@ -5,19 +5,45 @@
 
 #include <iostream>
 #include <fstream>
+#include <cfloat>
 
+#if defined(HEADLESS)
+#include <chrono>
+#else
 #include "SDL.h"
+#endif
 using namespace dae;
 
+namespace
+{
+	uint64_t GetPerformanceCounter()
+	{
+#if defined(HEADLESS)
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#else
+		return SDL_GetPerformanceCounter();
+#endif
+	}
+
+	uint64_t GetPerformanceFrequency()
+	{
+#if defined(HEADLESS)
+		return static_cast<uint64_t>(std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num);
+#else
+		return SDL_GetPerformanceFrequency();
+#endif
+	}
+}
+
 Timer::Timer()
 {
-	const uint64_t countsPerSecond = SDL_GetPerformanceFrequency();
+	const uint64_t countsPerSecond = GetPerformanceFrequency();
 	m_SecondsPerCount = 1.0f / static_cast<float>(countsPerSecond);
 }
 
 void Timer::Reset()
 {
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = GetPerformanceCounter();
 
 	m_BaseTime = currentTime;
 	m_PreviousTime = currentTime;
@@ -29,7 +55,7 @@ void Timer::Reset()
 
 void Timer::Start()
 {
-	const uint64_t startTime = SDL_GetPerformanceCounter();
+	const uint64_t startTime = GetPerformanceCounter();
 
 	if (m_IsStopped)
 	{
@@ -74,7 +100,7 @@ void Timer::Update()
 		return;
 	}
 
-	const uint64_t currentTime = SDL_GetPerformanceCounter();
+	const uint64_t currentTime = GetPerformanceCounter();
 	m_CurrentTime = currentTime;
 
 	m_ElapsedTime = (float)((m_CurrentTime - m_PreviousTime) * m_SecondsPerCount);
@@ -131,11 +157,17 @@ void Timer::Update()
 	}
 }
 
+void Timer::UpdateFixed(float elapsedTime)
+{
+	m_ElapsedTime = elapsedTime;
+	m_TotalTime += elapsedTime;
+}
+
 void Timer::Stop()
 {
 	if (!m_IsStopped)
 	{
-		const uint64_t currentTime = SDL_GetPerformanceCounter();
+		const uint64_t currentTime = GetPerformanceCounter();
 
 		m_StopTime = currentTime;
 		m_IsStopped = true;
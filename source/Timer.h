@@ -22,6 +22,8 @@ namespace dae
 		void Reset();
 		void Start();
 		void Update();
+		//Advance by a fixed step instead of the measured time, so offline renders animate the same on every run
+		void UpdateFixed(float elapsedTime);
 		void Stop();
 
 		uint32_t GetFPS() const { return m_FPS; };
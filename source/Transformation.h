@@ -26,12 +26,24 @@ namespace dae {
 			return matrix.TransformVector(v);
 		}
 
+		// Normals transform with the inverse transpose, so they stay perpendicular under non-uniform scaling.
+		Vector3 transformNormal(const Vector3& n) const {
+			return {
+				Vector3::Dot(n, inverse.GetAxisX()),
+				Vector3::Dot(n, inverse.GetAxisY()),
+				Vector3::Dot(n, inverse.GetAxisZ())
+			};
+		}
+
+		// The direction is not renormalized, so a distance t along the transformed ray is the same t along the original one.
 		Ray inverseTransformRay(const Ray& r) const {
 			Vector3 origin = inverse.TransformPoint(r.origin);
 			Vector3 dir = inverse.TransformVector(r.direction);
 			Ray ray = Ray();
 			ray.origin = origin;
 			ray.direction = dir;
+			ray.min = r.min;
+			ray.max = r.max;
 			return ray;
 		}
 
@@ -49,21 +61,21 @@ namespace dae {
 
 		static Transformation rotateX(float angle) {
 			Matrix transform = Matrix::CreateRotationX(angle);
-			Matrix inverse = transform.Transpose();
+			Matrix inverse = Matrix::Transpose(transform);
 
 			return Transformation(transform, inverse);
 		}
 
 		static Transformation rotateY(float angle) {
 			Matrix transform = Matrix::CreateRotationY(angle);
-			Matrix inverse = transform.Transpose();
+			Matrix inverse = Matrix::Transpose(transform);
 
 			return Transformation(transform, inverse);
 		}
 
 		static Transformation rotateZ(float angle) {
 			Matrix transform = Matrix::CreateRotationZ(angle);
-			Matrix inverse = transform.Transpose();
+			Matrix inverse = Matrix::Transpose(transform);
 
 			return Transformation(transform, inverse);
 		}
@@ -3,6 +3,9 @@
 #include "vector"
 #include "DataTypes.h"
 #include "Transformation.h"
+#include "BVH.h"
+#include "BVH8.h"
+#include "PackedTriangles.h"
 
 namespace dae
 {
@@ -28,7 +31,7 @@ namespace dae
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
+		MaterialIndex materialIndex{};
 
 		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
 
@@ -42,6 +45,22 @@ namespace dae
 		Vector3 minAABB{};
 		Vector3 maxAABB{};
 
+		BVH bvh{ SIMD::FloatN::Width };
+		PackedTriangles packedTriangles{};
+		//Set before the first transform update. The wide tree is derived from bvh and shares its packed triangles.
+		BVHLayout bvhLayout{ BVHLayout::Binary };
+		BVH8 bvh8{};
+
+		//Instancing: no transformed copy is made, the BVH stays in object space and rays are moved into object space instead.
+		//An instance can point to another instanced mesh to use its geometry and BVH, so many instances share one copy.
+		bool isInstanced{ false };
+		const TriangleMesh* pInstanceSource{ nullptr };
+		Transformation worldTransform{};
+
+		const TriangleMesh& GetGeometry() const
+		{
+			return pInstanceSource ? *pInstanceSource : *this;
+		}
 
 		void Translate(const Vector3& translation)
 		{
@@ -103,8 +122,13 @@ namespace dae
 		{
 			//Calculate Final Transform 
 			const Transformation finalTransform = scaleTransform.append(rotationTransform.append(translationTransform));
+			if (isInstanced) {
+				UpdateInstanceTransform(finalTransform);
+				return;
+			}
+
 			minAABB = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
-			maxAABB = Vector3{ FLT_MIN, FLT_MIN , FLT_MIN };
+			maxAABB = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
 
 			//Transform Positions (positions > transformedPositions)
 			if (transformedPositions.size() > 1) {
@@ -130,6 +154,50 @@ namespace dae
 			for (int i = 0; i < normals.size(); i++) {
 				transformedNormals.emplace_back(finalTransform.transformVector(normals[i]));
 			}
+
+			//Refit the acceleration structure to the transformed positions, it rebuilds itself when needed
+			bvh.Refit(transformedPositions, indices);
+			packedTriangles.Build(transformedPositions, indices, transformedNormals, bvh);
+			if (bvhLayout == BVHLayout::Wide8)
+				bvh8.Build(bvh);
+		}
+
+		void UpdateInstanceTransform(const Transformation& finalTransform)
+		{
+			worldTransform = finalTransform;
+			transformedPositions.clear();
+			transformedNormals.clear();
+
+			//The object space BVH only has to be built once, or again when triangles were added.
+			//A mesh loaded from its cache comes with the BVH already built.
+			if (!pInstanceSource && packedTriangles.triangleCount != indices.size() / 3) {
+				if (bvh.GetPrimitiveCount() != indices.size() / 3)
+					bvh.Build(positions, indices);
+				packedTriangles.Build(positions, indices, normals, bvh);
+				bvh8 = {};
+			}
+			if (!pInstanceSource && bvhLayout == BVHLayout::Wide8 && bvh8.IsEmpty())
+				bvh8.Build(bvh);
+
+			//World bounds are the transformed corners of the object space bounds
+			const BVH& geometryBVH = GetGeometry().bvh;
+			if (geometryBVH.IsEmpty())
+				return;
+
+			const Vector3& objectMin = geometryBVH.GetNodes()[0].minAABB;
+			const Vector3& objectMax = geometryBVH.GetNodes()[0].maxAABB;
+			minAABB = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+			maxAABB = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (int corner = 0; corner < 8; corner++) {
+				const Vector3 point{
+					(corner & 1) ? objectMax.x : objectMin.x,
+					(corner & 2) ? objectMax.y : objectMin.y,
+					(corner & 4) ? objectMax.z : objectMin.z
+				};
+				const Vector3 transformedPoint = finalTransform.transformPoint(point);
+				minAABB = Vector3::Min(minAABB, transformedPoint);
+				maxAABB = Vector3::Max(maxAABB, transformedPoint);
+			}
 		}
 	};
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include "Math.h"
 #include "DataTypes.h"
 #include "TriangleMesh.h"
@@ -192,68 +194,906 @@ namespace dae
 			HitRecord temp{};
 			return HitTest_Triangle(triangle, ray, temp, true);
 		}
+
+		// Same test as HitTest_Triangle for a triangle of a mesh, the edges and their cross product come precomputed from the packing.
+		inline bool HitTest_PackedTriangle(const PackedTriangles& triangles, uint32_t slot, TriangleCullMode cullMode, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const Vector3 normal = triangles.GetNormal(slot);
+			const Vector3 invDirection = -ray.direction;
+
+			switch (cullMode) {
+			case (TriangleCullMode::FrontFaceCulling):
+				if (Vector3::Dot(normal, invDirection) > -0.001)
+					return false;
+				break;
+			case (TriangleCullMode::BackFaceCulling):
+				if (Vector3::Dot(normal, invDirection) < 0.001)
+					return false;
+				break;
+			case (TriangleCullMode::NoCulling):
+				float dotNDir = Vector3::Dot(normal, invDirection);
+				if (dotNDir < 0.001 && dotNDir > -0.001)
+					return false;
+				break;
+			}
+
+			const Vector3 b = ray.origin - triangles.GetV0(slot);
+			const Vector3 cofE = triangles.GetCross(slot);
+			const float invDetA = 1.f / Vector3::Dot(invDirection, cofE);
+
+			const float t = Vector3::Dot(b, cofE) * invDetA;
+			if (t < ray.min || t > ray.max || hitRecord.t < t)
+				return false;
+
+			const float u = Vector3::Dot(invDirection, Vector3::Cross(b, triangles.GetEdge2(slot))) * invDetA;
+			if (u < 0 || u > 1)
+				return false;
+
+			const float v = Vector3::Dot(invDirection, Vector3::Cross(triangles.GetEdge1(slot), b)) * invDetA;
+			if (v < 0 || v + u > 1)
+				return false;
+
+			if (ignoreHitRecord)
+				return true;
+
+			hitRecord.t = t;
+			hitRecord.didHit = true;
+			hitRecord.normal = normal;
+			hitRecord.origin = ray.origin + t * ray.direction;
+
+			return true;
+		}
+
+		/* Leaf intersector: tests the ray against count (at most SIMD::FloatN::Width) packed triangles from firstSlot on at once.
+		*	Every lane runs the arithmetic of HitTest_PackedTriangle, the culling rules and barycentric bounds become lane masks.
+		*	On a hit the closest triangle is written to hitRecord and its slot to hitSlot, with the same tie breaking as testing them in order.
+		*/
+		inline bool HitTest_PackedTriangles(const PackedTriangles& triangles, uint32_t firstSlot, uint32_t count, TriangleCullMode cullMode,
+			const Ray& ray, HitRecord& hitRecord, uint32_t& hitSlot, bool ignoreHitRecord = false)
+		{
+			using SIMD::FloatN;
+			using SIMD::MaskN;
+
+			const FloatN dirX = FloatN::Broadcast(-ray.direction.x), dirY = FloatN::Broadcast(-ray.direction.y), dirZ = FloatN::Broadcast(-ray.direction.z);
+			const FloatN normalX = FloatN::Load(&triangles.normalX[firstSlot]);
+			const FloatN normalY = FloatN::Load(&triangles.normalY[firstSlot]);
+			const FloatN normalZ = FloatN::Load(&triangles.normalZ[firstSlot]);
+
+			// 0.001f and the double 0.001 of the scalar test have no float in between, so both cull the same triangles
+			const FloatN dotNDir = normalX * dirX + normalY * dirY + normalZ * dirZ;
+			const FloatN maxCull = FloatN::Broadcast(0.001f), minCull = FloatN::Broadcast(-0.001f);
+			MaskN rejected{};
+			switch (cullMode) {
+			case (TriangleCullMode::FrontFaceCulling):
+				rejected = dotNDir > minCull;
+				break;
+			case (TriangleCullMode::BackFaceCulling):
+				rejected = dotNDir < maxCull;
+				break;
+			case (TriangleCullMode::NoCulling):
+				rejected = (dotNDir < maxCull) & (dotNDir > minCull);
+				break;
+			}
+
+			// Most leaves are rejected by the culling or the distance test, skip the rest of the work for those
+			const MaskN candidates = FloatN::FirstLanes(count);
+			if (candidates.AndNot(rejected).GetBits() == 0)
+				return false;
+
+			const FloatN bX = FloatN::Broadcast(ray.origin.x) - FloatN::Load(&triangles.v0X[firstSlot]);
+			const FloatN bY = FloatN::Broadcast(ray.origin.y) - FloatN::Load(&triangles.v0Y[firstSlot]);
+			const FloatN bZ = FloatN::Broadcast(ray.origin.z) - FloatN::Load(&triangles.v0Z[firstSlot]);
+			const FloatN crossX = FloatN::Load(&triangles.crossX[firstSlot]);
+			const FloatN crossY = FloatN::Load(&triangles.crossY[firstSlot]);
+			const FloatN crossZ = FloatN::Load(&triangles.crossZ[firstSlot]);
+			const FloatN invDetA = FloatN::Broadcast(1.f) / (dirX * crossX + dirY * crossY + dirZ * crossZ);
+
+			const FloatN t = (bX * crossX + bY * crossY + bZ * crossZ) * invDetA;
+			rejected = rejected | (t < FloatN::Broadcast(ray.min)) | (t > FloatN::Broadcast(ray.max)) | (FloatN::Broadcast(hitRecord.t) < t);
+			if (candidates.AndNot(rejected).GetBits() == 0)
+				return false;
+
+			// u = Dot(-D, Cross(b, edge2)) / det(A)
+			const FloatN edge2X = FloatN::Load(&triangles.edge2X[firstSlot]);
+			const FloatN edge2Y = FloatN::Load(&triangles.edge2Y[firstSlot]);
+			const FloatN edge2Z = FloatN::Load(&triangles.edge2Z[firstSlot]);
+			const FloatN u = (dirX * (bY * edge2Z - bZ * edge2Y) + dirY * (bZ * edge2X - bX * edge2Z) + dirZ * (bX * edge2Y - bY * edge2X)) * invDetA;
+			const FloatN zero = FloatN::Broadcast(0.f), one = FloatN::Broadcast(1.f);
+			rejected = rejected | (u < zero) | (u > one);
+
+			// v = Dot(-D, Cross(edge1, b)) / det(A)
+			const FloatN edge1X = FloatN::Load(&triangles.edge1X[firstSlot]);
+			const FloatN edge1Y = FloatN::Load(&triangles.edge1Y[firstSlot]);
+			const FloatN edge1Z = FloatN::Load(&triangles.edge1Z[firstSlot]);
+			const FloatN v = (dirX * (edge1Y * bZ - edge1Z * bY) + dirY * (edge1Z * bX - edge1X * bZ) + dirZ * (edge1X * bY - edge1Y * bX)) * invDetA;
+			rejected = rejected | (v < zero) | (v + u > one);
+
+			const uint32_t hitLanes = candidates.AndNot(rejected).GetBits();
+			if (hitLanes == 0)
+				return false;
+
+			if (ignoreHitRecord)
+				return true;
+
+			// Pick the closest lane, a later lane wins ties like it would when testing the triangles one by one
+			float laneT[FloatN::Width];
+			t.Store(laneT);
+			uint32_t hitLane = 0;
+			float closestT = hitRecord.t;
+			for (uint32_t lane = 0; lane < FloatN::Width; lane++) {
+				if ((hitLanes & (1u << lane)) && !(closestT < laneT[lane])) {
+					closestT = laneT[lane];
+					hitLane = lane;
+				}
+			}
+
+			hitSlot = firstSlot + hitLane;
+			hitRecord.t = closestT;
+			hitRecord.didHit = true;
+			hitRecord.normal = triangles.GetNormal(hitSlot);
+			hitRecord.origin = ray.origin + closestT * ray.direction;
+
+			return true;
+		}
 #pragma endregion
 #pragma region TriangeMesh HitTest
-		inline bool SlabTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray) {
-			// Quick test to see whether a ray hits a Axis Aligned Bounding Box.
-			float tx1 = (mesh.minAABB.x - ray.origin.x) / ray.direction.x;
-			float tx2 = (mesh.maxAABB.x - ray.origin.x) / ray.direction.x;
+		// Quick test to see whether a ray hits an Axis Aligned Bounding Box. Returns the distance at which the ray enters the box, FLT_MAX if it misses.
+		inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& invDirection, float maxT) {
+			float tx1 = (minAABB.x - ray.origin.x) * invDirection.x;
+			float tx2 = (maxAABB.x - ray.origin.x) * invDirection.x;
 
 			float tmin = std::min(tx1, tx2);
 			float tmax = std::max(tx1, tx2);
 
-			float ty1 = (mesh.minAABB.y - ray.origin.y) / ray.direction.y;
-			float ty2 = (mesh.maxAABB.y - ray.origin.y) / ray.direction.y;
+			float ty1 = (minAABB.y - ray.origin.y) * invDirection.y;
+			float ty2 = (maxAABB.y - ray.origin.y) * invDirection.y;
 
 			tmin = std::max(tmin, std::min(ty1, ty2));
 			tmax = std::min(tmax, std::max(ty1, ty2));
 
-			float tz1 = (mesh.minAABB.z - ray.origin.z) / ray.direction.z;
-			float tz2 = (mesh.maxAABB.z - ray.origin.z) / ray.direction.z;
+			float tz1 = (minAABB.z - ray.origin.z) * invDirection.z;
+			float tz2 = (maxAABB.z - ray.origin.z) * invDirection.z;
 
 			tmin = std::max(tmin, std::min(tz1, tz2));
 			tmax = std::min(tmax, std::max(tz1, tz2));
 
-			return tmax > 0 && tmax >= tmin;
+			if (tmax >= tmin && tmax > ray.min && tmin < maxT)
+				return tmin;
+			return FLT_MAX;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		/* Walks a BVH nearest child first and calls intersectLeaf(firstSlot, primitiveCount) for every leaf the ray reaches.
+		*	The leaf covers bvh.GetPrimitiveIndices()[firstSlot] up to firstSlot + primitiveCount.
+		*	Nodes further away than hitRecord.t are culled, so the callback should update hitRecord when it finds a closer hit.
+		*	When the callback returns true the traversal stops immediately (used by the any-hit queries).
+		*	rootIndex walks only the subtree below that node.
+		*/
+		template<typename IntersectLeaf>
+		inline bool Traverse_BVHLeaves(const BVH& bvh, const Ray& ray, const HitRecord& hitRecord, IntersectLeaf&& intersectLeaf, uint32_t rootIndex = 0)
 		{
-			if (!SlabTest_TriangleMesh(mesh, ray)) {
+			if (bvh.IsEmpty())
+				return false;
+
+			const BVHNode* pNodes = bvh.GetNodes();
+			const BVHNode* pNode = &pNodes[rootIndex];
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+			if (SlabTest_AABB(pNode->minAABB, pNode->maxAABB, ray, invDirection, std::min(ray.max, hitRecord.t)) == FLT_MAX)
 				return false;
-			}
 
-			// If it hit the bounding box, loop to see whether it hits any triangles.
-			int nrTriangles = (int) mesh.indices.size() / 3;
-			for (int i = 0; i < nrTriangles; i++) {
-				// Find the indices of the triangle
-				int i0 = mesh.indices[i * 3];
-				int i1 = mesh.indices[i * 3 + 1];
-				int i2 = mesh.indices[i * 3 + 2];
-
-				// Retrieve the transformed positions of the mesh
-				Vector3 v0 = mesh.transformedPositions[i0];
-				Vector3 v1 = mesh.transformedPositions[i1];
-				Vector3 v2 = mesh.transformedPositions[i2];
-
-				// Test the triangle
-				Triangle triangle = Triangle(v0, v1, v2, mesh.transformedNormals[i]);
-				triangle.cullMode = mesh.cullMode;
-				if (GeometryUtils::HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord)) {
-					if (ignoreHitRecord)
+			uint32_t stack[BVH::MaxDepth];
+			int stackSize = 0;
+
+			while (true) {
+				if (pNode->IsLeaf()) {
+					if (intersectLeaf(pNode->leftFirst, pNode->primitiveCount))
 						return true;
-					hitRecord.materialIndex = mesh.materialIndex;
+
+					if (stackSize == 0)
+						break;
+					pNode = &pNodes[stack[--stackSize]];
+					continue;
+				}
+
+				const BVHNode* pChild1 = &pNodes[pNode->leftFirst];
+				const BVHNode* pChild2 = &pNodes[pNode->leftFirst + 1];
+				const float maxT = std::min(ray.max, hitRecord.t);
+				float dist1 = SlabTest_AABB(pChild1->minAABB, pChild1->maxAABB, ray, invDirection, maxT);
+				float dist2 = SlabTest_AABB(pChild2->minAABB, pChild2->maxAABB, ray, invDirection, maxT);
+
+				if (dist1 > dist2) {
+					std::swap(dist1, dist2);
+					std::swap(pChild1, pChild2);
+				}
+
+				if (dist1 == FLT_MAX) {
+					if (stackSize == 0)
+						break;
+					pNode = &pNodes[stack[--stackSize]];
+				}
+				else {
+					pNode = pChild1;
+					if (dist2 != FLT_MAX)
+						stack[stackSize++] = static_cast<uint32_t>(pChild2 - pNodes);
 				}
 			}
 
 			return false;
 		}
 
+		// Same walk as Traverse_BVHLeaves, calling intersectPrimitive(primitiveIndex) for every primitive in the leaves.
+		template<typename IntersectPrimitive>
+		inline bool Traverse_BVH(const BVH& bvh, const Ray& ray, const HitRecord& hitRecord, IntersectPrimitive&& intersectPrimitive)
+		{
+			const uint32_t* pPrimitiveIndices = bvh.GetPrimitiveIndices();
+			return Traverse_BVHLeaves(bvh, ray, hitRecord, [&](uint32_t firstSlot, uint32_t primitiveCount) {
+				for (uint32_t slot = firstSlot; slot < firstSlot + primitiveCount; slot++) {
+					if (intersectPrimitive(pPrimitiveIndices[slot]))
+						return true;
+				}
+				return false;
+				});
+		}
+
+		/* SlabTest_AABB for the children of a wide node, FloatN::Width children at a time with their bounds dequantized in the registers.
+		*	Returns a bit per child the ray enters before maxT, pDistances receives the distance at which it enters every child.
+		*/
+		inline uint32_t SlabTest_BVH8Children(const BVH8Node& node, const SIMD::FloatN rayOrigin[3], const SIMD::FloatN invDirection[3],
+			SIMD::FloatN rayMin, SIMD::FloatN maxT, float* pDistances)
+		{
+			using SIMD::FloatN;
+
+			const uint8_t* pQuantizedMins[3]{ node.minX, node.minY, node.minZ };
+			const uint8_t* pQuantizedMaxs[3]{ node.maxX, node.maxY, node.maxZ };
+			const FloatN origin[3]{ FloatN::Broadcast(node.origin.x), FloatN::Broadcast(node.origin.y), FloatN::Broadcast(node.origin.z) };
+			const FloatN step[3]{ FloatN::Broadcast(node.GetStep(0)), FloatN::Broadcast(node.GetStep(1)), FloatN::Broadcast(node.GetStep(2)) };
+
+			uint32_t hitBits = 0;
+			for (uint32_t firstChild = 0; firstChild < node.childCount; firstChild += FloatN::Width) {
+				const auto slab = [&](int axis, FloatN& t1, FloatN& t2) {
+					t1 = (origin[axis] + FloatN::LoadBytes(pQuantizedMins[axis] + firstChild) * step[axis] - rayOrigin[axis]) * invDirection[axis];
+					t2 = (origin[axis] + FloatN::LoadBytes(pQuantizedMaxs[axis] + firstChild) * step[axis] - rayOrigin[axis]) * invDirection[axis];
+				};
+
+				FloatN t1, t2;
+				slab(0, t1, t2);
+				FloatN tmin = FloatN::Min(t2, t1);
+				FloatN tmax = FloatN::Max(t2, t1);
+				for (int axis = 1; axis < 3; axis++) {
+					slab(axis, t1, t2);
+					tmin = FloatN::Max(FloatN::Min(t2, t1), tmin);
+					tmax = FloatN::Min(FloatN::Max(t2, t1), tmax);
+				}
+
+				tmin.Store(pDistances + firstChild);
+				const SIMD::MaskN hits = (tmax >= tmin) & (tmax > rayMin) & (tmin < maxT) & FloatN::FirstLanes(node.childCount - firstChild);
+				hitBits |= hits.GetBits() << firstChild;
+			}
+			return hitBits;
+		}
+
+		/* Traverse_BVHLeaves for the wide BVH, same callback and the same culling against hitRecord.t.
+		*	Every child the ray reaches goes on the stack sorted by distance, nearest on top. Entries behind a hit found in the meantime are skipped when popped.
+		*/
+		template<typename IntersectLeaf>
+		inline bool Traverse_BVH8Leaves(const BVH8& bvh, const Ray& ray, const HitRecord& hitRecord, IntersectLeaf&& intersectLeaf)
+		{
+			using SIMD::FloatN;
+
+			if (bvh.IsEmpty())
+				return false;
+
+			struct StackEntry
+			{
+				float distance;
+				uint32_t child;
+				uint32_t primitiveCount;
+			};
+
+			const BVH8Node* pNodes = bvh.GetNodes();
+			const FloatN rayOrigin[3]{ FloatN::Broadcast(ray.origin.x), FloatN::Broadcast(ray.origin.y), FloatN::Broadcast(ray.origin.z) };
+			const FloatN invDirection[3]{ FloatN::Broadcast(1.f / ray.direction.x), FloatN::Broadcast(1.f / ray.direction.y), FloatN::Broadcast(1.f / ray.direction.z) };
+			const FloatN rayMin = FloatN::Broadcast(ray.min);
+
+			StackEntry stack[BVH8::StackSize];
+			int stackSize = 0;
+			uint32_t nodeIndex = 0;
+
+			while (true) {
+				const BVH8Node& node = pNodes[nodeIndex];
+				float distances[BVH8::Width];
+				const uint32_t hitBits = SlabTest_BVH8Children(node, rayOrigin, invDirection, rayMin, FloatN::Broadcast(std::min(ray.max, hitRecord.t)), distances);
+
+				// Insertion sort onto the stack, farthest child at the bottom
+				const int firstEntry = stackSize;
+				for (uint32_t child = 0; child < node.childCount; child++) {
+					if (!(hitBits & (1u << child)))
+						continue;
+
+					const StackEntry entry{ distances[child], node.children[child], node.primitiveCounts[child] };
+					int position = stackSize++;
+					while (position > firstEntry && stack[position - 1].distance < entry.distance) {
+						stack[position] = stack[position - 1];
+						position--;
+					}
+					stack[position] = entry;
+				}
+
+				while (true) {
+					if (stackSize == 0)
+						return false;
+
+					const StackEntry entry = stack[--stackSize];
+					if (entry.distance >= std::min(ray.max, hitRecord.t))
+						continue;
+					if (entry.primitiveCount == 0) {
+						nodeIndex = entry.child;
+						break;
+					}
+					if (intersectLeaf(entry.child, entry.primitiveCount))
+						return true;
+				}
+			}
+		}
+
+		// Walks the tree the mesh geometry is set to use, see Traverse_BVHLeaves
+		template<typename IntersectLeaf>
+		inline bool Traverse_MeshLeaves(const TriangleMesh& geometry, const Ray& ray, const HitRecord& hitRecord, IntersectLeaf&& intersectLeaf)
+		{
+			if (geometry.bvhLayout == BVHLayout::Wide8) {
+				assert(geometry.bvh8.IsEmpty() == geometry.bvh.IsEmpty() && "The wide tree is built with the binary one, see Scene::SetBVHLayout");
+				return Traverse_BVH8Leaves(geometry.bvh8, ray, hitRecord, intersectLeaf);
+			}
+			return Traverse_BVHLeaves(geometry.bvh, ray, hitRecord, intersectLeaf);
+		}
+
+		// Instanced meshes are intersected in object space. The hit is moved back to world space once the closest triangle is known.
+		inline bool HitTest_TriangleMeshInstance(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			const TriangleMesh& geometry = mesh.GetGeometry();
+			const Ray objectRay = mesh.worldTransform.inverseTransformRay(ray);
+
+			bool didHit = false;
+			uint32_t hitSlot = 0;
+
+			const bool stopped = Traverse_MeshLeaves(geometry, objectRay, hitRecord, [&](uint32_t firstSlot, uint32_t triangleCount) {
+				const uint32_t endSlot = firstSlot + triangleCount;
+				for (uint32_t slot = firstSlot; slot < endSlot; slot += SIMD::FloatN::Width) {
+					if (GeometryUtils::HitTest_PackedTriangles(geometry.packedTriangles, slot, std::min(SIMD::FloatN::Width, endSlot - slot), mesh.cullMode,
+						objectRay, hitRecord, hitSlot, ignoreHitRecord)) {
+						if (ignoreHitRecord)
+							return true;
+						didHit = true;
+					}
+				}
+				return false;
+				});
+
+			if (didHit) {
+				const uint32_t hitTriangleIndex = geometry.bvh.GetPrimitiveIndices()[hitSlot];
+				hitRecord.materialIndex = mesh.materialIndex;
+				hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+				hitRecord.normal = mesh.worldTransform.transformNormal(geometry.normals[hitTriangleIndex]).Normalized();
+			}
+
+			return stopped || didHit;
+		}
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			if (mesh.isInstanced)
+				return HitTest_TriangleMeshInstance(mesh, ray, hitRecord, ignoreHitRecord);
+
+			bool didHit = false;
+
+			// The packed triangles follow the leaf order, so every leaf reads one contiguous range that fits the kernel lanes
+			const bool stopped = Traverse_MeshLeaves(mesh, ray, hitRecord, [&](uint32_t firstSlot, uint32_t triangleCount) {
+				const uint32_t endSlot = firstSlot + triangleCount;
+				for (uint32_t slot = firstSlot; slot < endSlot; slot += SIMD::FloatN::Width) {
+					uint32_t hitSlot{};
+					if (GeometryUtils::HitTest_PackedTriangles(mesh.packedTriangles, slot, std::min(SIMD::FloatN::Width, endSlot - slot), mesh.cullMode,
+						ray, hitRecord, hitSlot, ignoreHitRecord)) {
+						if (ignoreHitRecord)
+							return true;
+						hitRecord.materialIndex = mesh.materialIndex;
+						didHit = true;
+					}
+				}
+				return false;
+				});
+
+			return stopped || didHit;
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
 			HitRecord temp{};
 			return HitTest_TriangleMesh(mesh, ray, temp, true);
 		}
+#pragma endregion
+#pragma region Ray Packets
+		/* Packets trace the rays of a block of pixels together, one ray per SIMD lane (see RayPacket).
+		*	hitRecords holds one record per lane and lanes is a bit mask of the rays to test, every lane computes exactly what the single ray would.
+		*/
+
+		// SlabTest_AABB for every lane at once. Returns the lanes that hit the box before their maxT, tEnter is the distance at which each lane enters it.
+		inline SIMD::MaskN SlabTest_AABBPacket(const Vector3& minAABB, const Vector3& maxAABB, const RayPacket& packet, const SIMD::FloatN invDirection[3],
+			SIMD::FloatN maxT, SIMD::FloatN& tEnter)
+		{
+			using SIMD::FloatN;
+
+			// Min/Max take their operands swapped to pick the same value as std::min/std::max for ties and NaN
+			const FloatN tx1 = FloatN::Broadcast(minAABB.x - packet.origin.x) * invDirection[0];
+			const FloatN tx2 = FloatN::Broadcast(maxAABB.x - packet.origin.x) * invDirection[0];
+			FloatN tmin = FloatN::Min(tx2, tx1);
+			FloatN tmax = FloatN::Max(tx2, tx1);
+
+			const FloatN ty1 = FloatN::Broadcast(minAABB.y - packet.origin.y) * invDirection[1];
+			const FloatN ty2 = FloatN::Broadcast(maxAABB.y - packet.origin.y) * invDirection[1];
+			tmin = FloatN::Max(FloatN::Min(ty2, ty1), tmin);
+			tmax = FloatN::Min(FloatN::Max(ty2, ty1), tmax);
+
+			const FloatN tz1 = FloatN::Broadcast(minAABB.z - packet.origin.z) * invDirection[2];
+			const FloatN tz2 = FloatN::Broadcast(maxAABB.z - packet.origin.z) * invDirection[2];
+			tmin = FloatN::Max(FloatN::Min(tz2, tz1), tmin);
+			tmax = FloatN::Min(FloatN::Max(tz2, tz1), tmax);
+
+			tEnter = tmin;
+			return (tmax >= tmin) & (tmax > FloatN::Broadcast(packet.min)) & (tmin < maxT);
+		}
+
+		/* Walks a BVH with the whole packet, calling intersectLeaf(firstSlot, primitiveCount, lanes) with the lanes that reach the leaf.
+		*	Every node is tested once for all lanes and the child entered first is the one the active lanes reach first.
+		*	Once only a single lane is left in a subtree the packet has diverged, that subtree is walked with Traverse_BVHLeaves for the lone ray.
+		*/
+		template<typename IntersectLeaf>
+		inline void Traverse_BVHLeavesPacket(const BVH& bvh, const RayPacket& packet, const HitRecord* hitRecords, uint32_t lanes, IntersectLeaf&& intersectLeaf)
+		{
+			using SIMD::FloatN;
+			using SIMD::MaskN;
+
+			if (bvh.IsEmpty() || lanes == 0)
+				return;
+
+			const BVHNode* pNodes = bvh.GetNodes();
+
+			struct StackEntry
+			{
+				uint32_t nodeIndex;
+				uint32_t lanes;
+			};
+
+			const FloatN invDirection[3]{
+				FloatN::Broadcast(1.f) / FloatN::Load(packet.directionX),
+				FloatN::Broadcast(1.f) / FloatN::Load(packet.directionY),
+				FloatN::Broadcast(1.f) / FloatN::Load(packet.directionZ)
+			};
+
+			// A lane culls nodes behind the closest hit it has found so far
+			float laneMaxT[RayPacket::Size];
+			const auto updateMaxT = [&]() {
+				for (uint32_t lane = 0; lane < RayPacket::Size; lane++)
+					laneMaxT[lane] = std::min(packet.max, hitRecords[lane].t);
+				return FloatN::Load(laneMaxT);
+				};
+			FloatN maxT = updateMaxT();
+
+			FloatN tEnter{};
+			StackEntry stack[BVH::MaxDepth];
+			int stackSize = 0;
+			StackEntry entry{ 0, lanes & SlabTest_AABBPacket(pNodes[0].minAABB, pNodes[0].maxAABB, packet, invDirection, maxT, tEnter).GetBits() };
+
+			while (true) {
+				const BVHNode& node = pNodes[entry.nodeIndex];
+
+				if (entry.lanes != 0 && (entry.lanes & (entry.lanes - 1)) == 0) {
+					uint32_t lane = 0;
+					while (!(entry.lanes & (1u << lane)))
+						lane++;
+
+					Traverse_BVHLeaves(bvh, packet.GetRay(lane), hitRecords[lane], [&](uint32_t firstSlot, uint32_t primitiveCount) {
+						intersectLeaf(firstSlot, primitiveCount, entry.lanes);
+						return false;
+						}, entry.nodeIndex);
+					maxT = updateMaxT();
+					entry.lanes = 0;
+				}
+				else if (entry.lanes != 0 && node.IsLeaf()) {
+					intersectLeaf(node.leftFirst, node.primitiveCount, entry.lanes);
+					maxT = updateMaxT();
+					entry.lanes = 0;
+				}
+				else if (entry.lanes != 0) {
+					FloatN tEnter1{}, tEnter2{};
+					const BVHNode& child1 = pNodes[node.leftFirst];
+					const BVHNode& child2 = pNodes[node.leftFirst + 1];
+					StackEntry near{ node.leftFirst, entry.lanes & SlabTest_AABBPacket(child1.minAABB, child1.maxAABB, packet, invDirection, maxT, tEnter1).GetBits() };
+					StackEntry far{ node.leftFirst + 1, entry.lanes & SlabTest_AABBPacket(child2.minAABB, child2.maxAABB, packet, invDirection, maxT, tEnter2).GetBits() };
+
+					if (near.lanes != 0 && far.lanes != 0) {
+						// Enter the child that the first of the active lanes reaches first
+						float laneEnter1[RayPacket::Size], laneEnter2[RayPacket::Size];
+						tEnter1.Store(laneEnter1);
+						tEnter2.Store(laneEnter2);
+						float dist1 = FLT_MAX, dist2 = FLT_MAX;
+						for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+							if (near.lanes & (1u << lane))
+								dist1 = std::min(dist1, laneEnter1[lane]);
+							if (far.lanes & (1u << lane))
+								dist2 = std::min(dist2, laneEnter2[lane]);
+						}
+						if (dist1 > dist2)
+							std::swap(near, far);
+
+						stack[stackSize++] = far;
+						entry = near;
+					}
+					else {
+						entry = near.lanes != 0 ? near : far;
+					}
+					continue;
+				}
+
+				if (stackSize == 0)
+					break;
+				entry = stack[--stackSize];
+			}
+		}
+
+		// Same walk as Traverse_BVHLeavesPacket, calling intersectPrimitive(primitiveIndex, lanes) for every primitive in the leaves.
+		template<typename IntersectPrimitive>
+		inline void Traverse_BVHPacket(const BVH& bvh, const RayPacket& packet, const HitRecord* hitRecords, uint32_t lanes, IntersectPrimitive&& intersectPrimitive)
+		{
+			const uint32_t* pPrimitiveIndices = bvh.GetPrimitiveIndices();
+			Traverse_BVHLeavesPacket(bvh, packet, hitRecords, lanes, [&](uint32_t firstSlot, uint32_t primitiveCount, uint32_t leafLanes) {
+				for (uint32_t slot = firstSlot; slot < firstSlot + primitiveCount; slot++)
+					intersectPrimitive(pPrimitiveIndices[slot], leafLanes);
+				});
+		}
+
+		// HitTest_Sphere for every lane, the terms that only depend on the shared origin are computed once.
+		inline void HitTest_SpherePacket(const Sphere& sphere, const RayPacket& packet, HitRecord* hitRecords, uint32_t lanes)
+		{
+			using SIMD::FloatN;
+
+			const Vector3 offset = packet.origin - sphere.origin;
+			const float c = Vector3::Dot(offset, offset) - Square(sphere.radius);
+
+			// b = Dot(2 * dir, offset), discriminant = b*b - 4*c
+			const FloatN two = FloatN::Broadcast(2.f);
+			const FloatN b = (two * FloatN::Load(packet.directionX)) * FloatN::Broadcast(offset.x)
+				+ (two * FloatN::Load(packet.directionY)) * FloatN::Broadcast(offset.y)
+				+ (two * FloatN::Load(packet.directionZ)) * FloatN::Broadcast(offset.z);
+			const FloatN discriminant = b * b - FloatN::Broadcast(4 * c);
+
+			lanes &= (discriminant > FloatN::Broadcast(0.f)).GetBits();
+			if (lanes == 0)
+				return;
+
+			// The roots are taken per lane, in double precision like the single ray test
+			float laneB[RayPacket::Size], laneDiscriminant[RayPacket::Size];
+			b.Store(laneB);
+			discriminant.Store(laneDiscriminant);
+
+			for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+				if (!(lanes & (1u << lane)))
+					continue;
+
+				float t = -laneB[lane] - sqrt(laneDiscriminant[lane]);
+				t = t / 2;
+				if (t < packet.min || t > packet.max) {
+					t = -laneB[lane] + sqrt(laneDiscriminant[lane]);
+					t = t / 2;
+					if (t < packet.min || t > packet.max)
+						continue;
+				}
+
+				HitRecord& hitRecord = hitRecords[lane];
+				hitRecord.didHit = true;
+				if (hitRecord.t > t) {
+					const Ray ray = packet.GetRay(lane);
+					hitRecord.t = t;
+					hitRecord.materialIndex = sphere.materialIndex;
+					hitRecord.origin = ray.origin + ray.direction * t;
+					hitRecord.normal = (hitRecord.origin - sphere.origin) / sphere.radius;
+				}
+			}
+		}
+
+		/* Meshes share the node visits of the packet, the leaves run the wide triangle kernel for each lane that reaches them.
+		*	Instanced meshes move the packet to object space first, like HitTest_TriangleMeshInstance does for a single ray.
+		*/
+		inline void HitTest_TriangleMeshPacket(const TriangleMesh& mesh, const RayPacket& packet, HitRecord* hitRecords, uint32_t lanes)
+		{
+			// A lone ray gains nothing from the packet, the wide BVH is walked one ray at a time
+			if ((lanes & (lanes - 1)) == 0 || mesh.GetGeometry().bvhLayout == BVHLayout::Wide8) {
+				for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+					if (lanes & (1u << lane))
+						HitTest_TriangleMesh(mesh, packet.GetRay(lane), hitRecords[lane]);
+				}
+				return;
+			}
+
+			const TriangleMesh& geometry = mesh.GetGeometry();
+			RayPacket objectPacket = packet;
+			if (mesh.isInstanced) {
+				for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+					const Ray objectRay = mesh.worldTransform.inverseTransformRay(packet.GetRay(lane));
+					objectPacket.origin = objectRay.origin;
+					objectPacket.directionX[lane] = objectRay.direction.x;
+					objectPacket.directionY[lane] = objectRay.direction.y;
+					objectPacket.directionZ[lane] = objectRay.direction.z;
+				}
+			}
+
+			uint32_t hitLanes = 0;
+			uint32_t hitSlots[RayPacket::Size]{};
+
+			Traverse_BVHLeavesPacket(geometry.bvh, objectPacket, hitRecords, lanes, [&](uint32_t firstSlot, uint32_t triangleCount, uint32_t leafLanes) {
+				const uint32_t endSlot = firstSlot + triangleCount;
+				for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+					if (!(leafLanes & (1u << lane)))
+						continue;
+
+					const Ray objectRay = objectPacket.GetRay(lane);
+					for (uint32_t slot = firstSlot; slot < endSlot; slot += SIMD::FloatN::Width) {
+						if (HitTest_PackedTriangles(geometry.packedTriangles, slot, std::min(SIMD::FloatN::Width, endSlot - slot), mesh.cullMode,
+							objectRay, hitRecords[lane], hitSlots[lane]))
+							hitLanes |= 1u << lane;
+					}
+				}
+				});
+
+			for (uint32_t lane = 0; lane < RayPacket::Size; lane++) {
+				if (!(hitLanes & (1u << lane)))
+					continue;
+
+				HitRecord& hitRecord = hitRecords[lane];
+				hitRecord.materialIndex = mesh.materialIndex;
+				if (mesh.isInstanced) {
+					const Ray ray = packet.GetRay(lane);
+					hitRecord.origin = ray.origin + hitRecord.t * ray.direction;
+					hitRecord.normal = mesh.worldTransform.transformNormal(geometry.normals[geometry.bvh.GetPrimitiveIndices()[hitSlots[lane]]]).Normalized();
+				}
+			}
+		}
+#pragma endregion
+#pragma region Occlusion
+		/* Any-hit tests for shadow rays: they only answer whether something lies between ray.min and ray.max.
+		*	No hit record is filled in, the first hit ends the query and the BVH is walked without sorting the children.
+		*	The arithmetic is the same as the closest-hit tests, so both agree on every ray.
+		*/
+		inline bool Occludes_Sphere(const Sphere& sphere, const Ray& ray)
+		{
+			const Vector3 offset = ray.origin - sphere.origin;
+			const float b = Vector3::Dot(2 * ray.direction, offset);
+			const float c = Vector3::Dot(offset, offset) - Square(sphere.radius);
+
+			const float discriminant = b * b - 4 * c;
+			if (!(discriminant > 0))
+				return false;
+
+			float t = -b - sqrt(discriminant);
+			t = t / 2;
+			if (!(t < ray.min || t > ray.max))
+				return true;
+
+			t = -b + sqrt(discriminant);
+			t = t / 2;
+			return !(t < ray.min || t > ray.max);
+		}
+
+		inline bool Occludes_Plane(const Plane& plane, const Ray& ray)
+		{
+			float t = Vector3::Dot((plane.origin - ray.origin), plane.normal);
+			t = t / Vector3::Dot(ray.direction, plane.normal);
+			return t > ray.min && t < ray.max;
+		}
+
+		// Culling of a triangle seen along -ray.direction, with the thresholds of HitTest_Triangle
+		inline bool IsCulled(TriangleCullMode cullMode, float dotNDir)
+		{
+			switch (cullMode) {
+			case (TriangleCullMode::FrontFaceCulling):
+				return dotNDir > -0.001;
+			case (TriangleCullMode::BackFaceCulling):
+				return dotNDir < 0.001;
+			case (TriangleCullMode::NoCulling):
+				return dotNDir < 0.001 && dotNDir > -0.001;
+			}
+			return false;
+		}
+
+		inline bool Occludes_Triangle(const Triangle& triangle, const Ray& ray)
+		{
+			const Vector3 invDirection = -ray.direction;
+			if (IsCulled(triangle.cullMode, Vector3::Dot(triangle.normal, invDirection)))
+				return false;
+
+			const Vector3 b = ray.origin - triangle.v0;
+			const Vector3 e10 = triangle.v1 - triangle.v0;
+			const Vector3 e20 = triangle.v2 - triangle.v0;
+
+			const Vector3 cofE = Vector3::Cross(e10, e20);
+			const float invDetA = 1.f / Vector3::Dot(invDirection, cofE);
+
+			const float t = Vector3::Dot(b, cofE) * invDetA;
+			if (t < ray.min || t > ray.max)
+				return false;
+
+			const float u = Vector3::Dot(invDirection, Vector3::Cross(b, e20)) * invDetA;
+			if (u < 0 || u > 1)
+				return false;
+
+			const float v = Vector3::Dot(invDirection, Vector3::Cross(e10, b)) * invDetA;
+			return !(v < 0 || v + u > 1);
+		}
+
+		// HitTest_PackedTriangles without the closest lane search, true as soon as any of the count triangles is hit.
+		inline bool Occludes_PackedTriangles(const PackedTriangles& triangles, uint32_t firstSlot, uint32_t count, TriangleCullMode cullMode, const Ray& ray)
+		{
+			using SIMD::FloatN;
+			using SIMD::MaskN;
+
+			const FloatN dirX = FloatN::Broadcast(-ray.direction.x), dirY = FloatN::Broadcast(-ray.direction.y), dirZ = FloatN::Broadcast(-ray.direction.z);
+			const FloatN dotNDir = FloatN::Load(&triangles.normalX[firstSlot]) * dirX + FloatN::Load(&triangles.normalY[firstSlot]) * dirY
+				+ FloatN::Load(&triangles.normalZ[firstSlot]) * dirZ;
+			const FloatN maxCull = FloatN::Broadcast(0.001f), minCull = FloatN::Broadcast(-0.001f);
+			MaskN rejected{};
+			switch (cullMode) {
+			case (TriangleCullMode::FrontFaceCulling):
+				rejected = dotNDir > minCull;
+				break;
+			case (TriangleCullMode::BackFaceCulling):
+				rejected = dotNDir < maxCull;
+				break;
+			case (TriangleCullMode::NoCulling):
+				rejected = (dotNDir < maxCull) & (dotNDir > minCull);
+				break;
+			}
+
+			const MaskN candidates = FloatN::FirstLanes(count);
+			if (candidates.AndNot(rejected).GetBits() == 0)
+				return false;
+
+			const FloatN bX = FloatN::Broadcast(ray.origin.x) - FloatN::Load(&triangles.v0X[firstSlot]);
+			const FloatN bY = FloatN::Broadcast(ray.origin.y) - FloatN::Load(&triangles.v0Y[firstSlot]);
+			const FloatN bZ = FloatN::Broadcast(ray.origin.z) - FloatN::Load(&triangles.v0Z[firstSlot]);
+			const FloatN crossX = FloatN::Load(&triangles.crossX[firstSlot]);
+			const FloatN crossY = FloatN::Load(&triangles.crossY[firstSlot]);
+			const FloatN crossZ = FloatN::Load(&triangles.crossZ[firstSlot]);
+			const FloatN invDetA = FloatN::Broadcast(1.f) / (dirX * crossX + dirY * crossY + dirZ * crossZ);
+
+			const FloatN t = (bX * crossX + bY * crossY + bZ * crossZ) * invDetA;
+			rejected = rejected | (t < FloatN::Broadcast(ray.min)) | (t > FloatN::Broadcast(ray.max));
+			if (candidates.AndNot(rejected).GetBits() == 0)
+				return false;
+
+			const FloatN edge2X = FloatN::Load(&triangles.edge2X[firstSlot]);
+			const FloatN edge2Y = FloatN::Load(&triangles.edge2Y[firstSlot]);
+			const FloatN edge2Z = FloatN::Load(&triangles.edge2Z[firstSlot]);
+			const FloatN u = (dirX * (bY * edge2Z - bZ * edge2Y) + dirY * (bZ * edge2X - bX * edge2Z) + dirZ * (bX * edge2Y - bY * edge2X)) * invDetA;
+			const FloatN zero = FloatN::Broadcast(0.f), one = FloatN::Broadcast(1.f);
+			rejected = rejected | (u < zero) | (u > one);
+
+			const FloatN edge1X = FloatN::Load(&triangles.edge1X[firstSlot]);
+			const FloatN edge1Y = FloatN::Load(&triangles.edge1Y[firstSlot]);
+			const FloatN edge1Z = FloatN::Load(&triangles.edge1Z[firstSlot]);
+			const FloatN v = (dirX * (edge1Y * bZ - edge1Z * bY) + dirY * (edge1Z * bX - edge1X * bZ) + dirZ * (edge1X * bY - edge1Y * bX)) * invDetA;
+			rejected = rejected | (v < zero) | (v + u > one);
+
+			return candidates.AndNot(rejected).GetBits() != 0;
+		}
+
+		// SlabTest_AABB reduced to the yes or no answer, against the fixed extent of the ray.
+		inline bool Overlaps_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& invDirection)
+		{
+			const float tx1 = (minAABB.x - ray.origin.x) * invDirection.x;
+			const float tx2 = (maxAABB.x - ray.origin.x) * invDirection.x;
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			const float ty1 = (minAABB.y - ray.origin.y) * invDirection.y;
+			const float ty2 = (maxAABB.y - ray.origin.y) * invDirection.y;
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1 = (minAABB.z - ray.origin.z) * invDirection.z;
+			const float tz2 = (maxAABB.z - ray.origin.z) * invDirection.z;
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			return tmax >= tmin && tmax > ray.min && tmin < ray.max;
+		}
+
+		/* Walks a BVH depth first in node order and calls occludesLeaf(firstSlot, primitiveCount) for every leaf the ray reaches.
+		*	Returns true as soon as a leaf reports a hit. Children are not sorted by distance, any hit will do.
+		*/
+		template<typename OccludesLeaf>
+		inline bool Traverse_BVHOcclusion(const BVH& bvh, const Ray& ray, OccludesLeaf&& occludesLeaf)
+		{
+			if (bvh.IsEmpty())
+				return false;
+
+			const BVHNode* pNodes = bvh.GetNodes();
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+			if (!Overlaps_AABB(pNodes[0].minAABB, pNodes[0].maxAABB, ray, invDirection))
+				return false;
+
+			uint32_t stack[BVH::MaxDepth];
+			int stackSize = 0;
+			const BVHNode* pNode = &pNodes[0];
+
+			while (true) {
+				if (pNode->IsLeaf()) {
+					if (occludesLeaf(pNode->leftFirst, pNode->primitiveCount))
+						return true;
+
+					if (stackSize == 0)
+						break;
+					pNode = &pNodes[stack[--stackSize]];
+					continue;
+				}
+
+				const BVHNode& child1 = pNodes[pNode->leftFirst];
+				const BVHNode& child2 = pNodes[pNode->leftFirst + 1];
+				const bool overlaps1 = Overlaps_AABB(child1.minAABB, child1.maxAABB, ray, invDirection);
+				const bool overlaps2 = Overlaps_AABB(child2.minAABB, child2.maxAABB, ray, invDirection);
+
+				if (overlaps1) {
+					if (overlaps2)
+						stack[stackSize++] = pNode->leftFirst + 1;
+					pNode = &child1;
+				}
+				else if (overlaps2) {
+					pNode = &child2;
+				}
+				else {
+					if (stackSize == 0)
+						break;
+					pNode = &pNodes[stack[--stackSize]];
+				}
+			}
+
+			return false;
+		}
+
+		// pHitSlot receives the first of the packed triangles that contain the hit
+		inline bool Occludes_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, uint32_t* pHitSlot = nullptr)
+		{
+			const TriangleMesh& geometry = mesh.GetGeometry();
+			const Ray objectRay = mesh.isInstanced ? mesh.worldTransform.inverseTransformRay(ray) : ray;
+
+			const auto occludesLeaf = [&](uint32_t firstSlot, uint32_t triangleCount) {
+				const uint32_t endSlot = firstSlot + triangleCount;
+				for (uint32_t slot = firstSlot; slot < endSlot; slot += SIMD::FloatN::Width) {
+					if (Occludes_PackedTriangles(geometry.packedTriangles, slot, std::min(SIMD::FloatN::Width, endSlot - slot), mesh.cullMode, objectRay)) {
+						if (pHitSlot)
+							*pHitSlot = slot;
+						return true;
+					}
+				}
+				return false;
+			};
+
+			// The wide walk never finds a hit record to cull against, so it stops at the first leaf that reports one
+			if (geometry.bvhLayout == BVHLayout::Wide8) {
+				assert(geometry.bvh8.IsEmpty() == geometry.bvh.IsEmpty() && "The wide tree is built with the binary one, see Scene::SetBVHLayout");
+				return Traverse_BVH8Leaves(geometry.bvh8, objectRay, HitRecord{}, occludesLeaf);
+			}
+			return Traverse_BVHOcclusion(geometry.bvh, objectRay, occludesLeaf);
+		}
+
+		// Tests one register of packed triangles from firstSlot on without walking the BVH, for the slot an earlier query reported.
+		inline bool Occludes_TriangleMeshSlots(const TriangleMesh& mesh, const Ray& ray, uint32_t firstSlot)
+		{
+			const TriangleMesh& geometry = mesh.GetGeometry();
+			const uint32_t triangleCount = geometry.packedTriangles.triangleCount;
+			if (firstSlot >= triangleCount)
+				return false;
+
+			const Ray objectRay = mesh.isInstanced ? mesh.worldTransform.inverseTransformRay(ray) : ray;
+			return Occludes_PackedTriangles(geometry.packedTriangles, firstSlot, std::min(SIMD::FloatN::Width, triangleCount - firstSlot), mesh.cullMode, objectRay);
+		}
 #pragma endregion
 	}
 
@@ -329,6 +1169,55 @@ namespace dae
 
 			return true;
 		}
+
+		//Writes 0xAARRGGBB pixels as an uncompressed 24 bit BMP, the same format SDL_SaveBMP gives us for the window
+		static bool WriteBMP(const std::string& filename, const uint32_t* pPixels, int width, int height)
+		{
+			std::ofstream file(filename, std::ios::binary);
+			if (!file)
+				return false;
+
+			//Every row is padded to a multiple of 4 bytes
+			const uint32_t rowSize = (width * 3 + 3) & ~3u;
+			const uint32_t imageSize = rowSize * height;
+			const uint32_t headerSize = 14 + 40;
+
+			auto write16 = [&file](uint16_t value) { file.put(char(value & 0xFF)).put(char(value >> 8)); };
+			auto write32 = [&file](uint32_t value) { for (int i = 0; i < 4; i++) file.put(char((value >> (i * 8)) & 0xFF)); };
+
+			//File header
+			file.put('B').put('M');
+			write32(headerSize + imageSize);
+			write32(0);
+			write32(headerSize);
+
+			//Info header
+			write32(40);
+			write32(uint32_t(width));
+			write32(uint32_t(height));
+			write16(1);
+			write16(24);
+			write32(0);
+			write32(imageSize);
+			write32(2835);
+			write32(2835);
+			write32(0);
+			write32(0);
+
+			//Rows are stored bottom-up, pixels as BGR
+			std::vector<char> row(rowSize, 0);
+			for (int y = height - 1; y >= 0; y--) {
+				for (int x = 0; x < width; x++) {
+					const uint32_t pixel = pPixels[x + y * width];
+					row[x * 3] = char(pixel & 0xFF);
+					row[x * 3 + 1] = char((pixel >> 8) & 0xFF);
+					row[x * 3 + 2] = char((pixel >> 16) & 0xFF);
+				}
+				file.write(row.data(), rowSize);
+			}
+
+			return bool(file);
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "SIMD.h"
 
 namespace dae
 {
 	struct Vector4;
-	struct Vector3
+	// With SIMD_MATH the vector is padded to 16 bytes so it loads as one SSE register, the padding lane is unspecified.
+	struct SIMD_ALIGN Vector3
 	{
 		float x{};
 		float y{};
@@ -56,6 +62,208 @@ namespace dae
 	//Global Operators
 	inline Vector3 operator*(float scale, const Vector3& v)
 	{
-		return { v.x * scale, v.y * scale, v.z * scale };
+		return v * scale;
+	}
+
+#if defined(SIMD_MATH)
+	namespace SIMD
+	{
+		inline __m128 Load(const Vector3& v)
+		{
+			return _mm_load_ps(&v.x);
+		}
+
+		inline Vector3 Store(__m128 v)
+		{
+			Vector3 result;
+			_mm_store_ps(&result.x, v);
+			return result;
+		}
+
+		// Adds up the first three lanes in the same order as the scalar code, so both paths give the same result.
+		inline float HorizontalAdd3(__m128 v)
+		{
+			__m128 sum = _mm_add_ss(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+			sum = _mm_add_ss(sum, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+			return _mm_cvtss_f32(sum);
+		}
+	}
+#endif
+
+	// The hot operations are defined inline, every intersection test goes through them.
+#pragma region Inline Definitions
+	inline Vector3::Vector3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+	inline Vector3::Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
+
+	inline float Vector3::Magnitude() const
+	{
+		return sqrtf(SqrMagnitude());
+	}
+
+	inline float Vector3::SqrMagnitude() const
+	{
+		return Dot(*this, *this);
+	}
+
+	inline float Vector3::Normalize()
+	{
+		const float m = Magnitude();
+		*this /= m;
+
+		return m;
+	}
+
+	inline Vector3 Vector3::Normalized() const
+	{
+		const float m = Magnitude();
+		return *this / m;
+	}
+
+	inline float Vector3::Dot(const Vector3& v1, const Vector3& v2)
+	{
+#if defined(SIMD_MATH)
+		return SIMD::HorizontalAdd3(_mm_mul_ps(SIMD::Load(v1), SIMD::Load(v2)));
+#else
+		return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+#endif
+	}
+
+	inline Vector3 Vector3::Cross(const Vector3& v1, const Vector3& v2)
+	{
+#if defined(SIMD_MATH)
+		// (v1.yzx * v2.zxy) - (v1.zxy * v2.yzx)
+		const __m128 a = SIMD::Load(v1), b = SIMD::Load(v2);
+		const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)), bZXY = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+		const __m128 aZXY = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2)), bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		return SIMD::Store(_mm_sub_ps(_mm_mul_ps(aYZX, bZXY), _mm_mul_ps(aZXY, bYZX)));
+#else
+		float x = v1.y * v2.z - v1.z * v2.y;
+		float y = v1.z * v2.x - v1.x * v2.z;
+		float z = v1.x * v2.y - v1.y * v2.x;
+
+		return Vector3(x, y, z);
+#endif
+	}
+
+	inline Vector3 Vector3::CreateHalfvector(const Vector3& v1, const Vector3& v2)
+	{
+		return (v1 + v2) / 2;
+	}
+
+	inline Vector3 Vector3::Reflect(const Vector3& v1, const Vector3& v2)
+	{
+		return v1 - (2.f * Vector3::Dot(v1, v2) * v2);
+	}
+
+	inline Vector3 Vector3::Min(const Vector3& v1, const Vector3& v2)
+	{
+#if defined(SIMD_MATH)
+		// Operands swapped to pick the same element as std::min when both are equal
+		return SIMD::Store(_mm_min_ps(SIMD::Load(v2), SIMD::Load(v1)));
+#else
+		return {
+			std::min(v1.x, v2.x),
+			std::min(v1.y, v2.y),
+			std::min(v1.z, v2.z)
+		};
+#endif
+	}
+
+	inline Vector3 Vector3::Max(const Vector3& v1, const Vector3& v2)
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_max_ps(SIMD::Load(v2), SIMD::Load(v1)));
+#else
+		return {
+			std::max(v1.x, v2.x),
+			std::max(v1.y, v2.y),
+			std::max(v1.z, v2.z)
+		};
+#endif
+	}
+
+	inline Vector3 Vector3::operator*(float scale) const
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_mul_ps(SIMD::Load(*this), _mm_set1_ps(scale)));
+#else
+		return { x * scale, y * scale, z * scale };
+#endif
+	}
+
+	inline Vector3 Vector3::operator/(float scale) const
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_div_ps(SIMD::Load(*this), _mm_set1_ps(scale)));
+#else
+		return { x / scale, y / scale, z / scale };
+#endif
+	}
+
+	inline Vector3 Vector3::operator+(const Vector3& v) const
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_add_ps(SIMD::Load(*this), SIMD::Load(v)));
+#else
+		return { x + v.x, y + v.y, z + v.z };
+#endif
+	}
+
+	inline Vector3 Vector3::operator-(const Vector3& v) const
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_sub_ps(SIMD::Load(*this), SIMD::Load(v)));
+#else
+		return { x - v.x, y - v.y, z - v.z };
+#endif
+	}
+
+	inline Vector3 Vector3::operator-() const
+	{
+#if defined(SIMD_MATH)
+		return SIMD::Store(_mm_xor_ps(SIMD::Load(*this), _mm_set1_ps(-0.f)));
+#else
+		return { -x ,-y,-z };
+#endif
+	}
+
+	inline Vector3& Vector3::operator*=(float scale)
+	{
+		return *this = *this * scale;
+	}
+
+	inline Vector3& Vector3::operator/=(float scale)
+	{
+		return *this = *this / scale;
+	}
+
+	inline Vector3& Vector3::operator-=(const Vector3& v)
+	{
+		return *this = *this - v;
+	}
+
+	inline Vector3& Vector3::operator+=(const Vector3& v)
+	{
+		return *this = *this + v;
+	}
+
+	inline float& Vector3::operator[](int index)
+	{
+		assert(index <= 2 && index >= 0);
+
+		if (index == 0) return x;
+		if (index == 1) return y;
+		return z;
+	}
+
+	inline float Vector3::operator[](int index) const
+	{
+		assert(index <= 2 && index >= 0);
+
+		if (index == 0) return x;
+		if (index == 1) return y;
+		return z;
 	}
+#pragma endregion
 }
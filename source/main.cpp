@@ -6,9 +6,12 @@
 
 //Standard includes
 #include <iostream>
+#include <vector>
 
 //Project includes
 #include "Timer.h"
+#include "DynamicResolution.h"
+#include "FramePipeline.h"
 #include "Renderer.h"
 #include "Scene.h"
 
@@ -42,11 +45,19 @@ int main(int argc, char* args[])
 		return 1;
 
 	//Initialize "framework"
+	//Frames are rendered offscreen on the render thread and copied to the window surface by this one
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = new Renderer(width, height);
+	SDL_Surface* pWindowSurface = SDL_GetWindowSurface(pWindow);
 
+	//Double-buffered scene: the back one is updated while the render thread works on the front one
 	const auto pScene = new Scene_W4_ReferenceScene;
+	const auto pBackScene = new Scene_W4_ReferenceScene;
+	pScene->SetThreadPool(&pRenderer->GetThreadPool());
+	pBackScene->SetThreadPool(&pRenderer->GetThreadPool());
 	pScene->Initialize();
+	pBackScene->Initialize();
+	const auto pPipeline = new FramePipeline(pRenderer, pScene, pBackScene);
 
 	//Start loop
 	pTimer->Start();
@@ -54,6 +65,32 @@ int main(int argc, char* args[])
 	// Start Benchmark
 	// pTimer->StartBenchmark();
 
+	//Holds 30 FPS while the view changes by lowering the render resolution
+	DynamicResolution dynamicResolution{ 1.f / 30.f };
+	bool useDynamicResolution = true;
+	//Coarse to fine preview, a frame is dropped as soon as the camera gets new input
+	bool useRefinement = false;
+
+	//Keys that change renderer settings wait until the renderer is idle
+	std::vector<SDL_Scancode> rendererKeys{};
+	const auto applyRendererKey = [pRenderer](SDL_Scancode key)
+	{
+		if (key == SDL_SCANCODE_F2) {
+			pRenderer->m_colorManager.ToggleShadows();
+			pRenderer->ResetAccumulation();
+		}
+		if (key == SDL_SCANCODE_F3) {
+			pRenderer->m_colorManager.CycleLightingMode();
+			pRenderer->ResetAccumulation();
+		}
+		if (key == SDL_SCANCODE_F4)
+			pRenderer->TogglePacketTracing();
+		if (key == SDL_SCANCODE_F5)
+			pRenderer->ToggleProgressive();
+		if (key == SDL_SCANCODE_F7)
+			pRenderer->ToggleAdaptiveSampling();
+	};
+
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
@@ -73,12 +110,19 @@ int main(int argc, char* args[])
 			case SDL_KEYUP:
 				if(e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
-				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->m_colorManager.ToggleShadows();
-				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
-					pRenderer->m_colorManager.CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F2 || e.key.keysym.scancode == SDL_SCANCODE_F3 || e.key.keysym.scancode == SDL_SCANCODE_F4
+					|| e.key.keysym.scancode == SDL_SCANCODE_F5 || e.key.keysym.scancode == SDL_SCANCODE_F7)
+					rendererKeys.push_back(e.key.keysym.scancode);
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8) {
+					useDynamicResolution = !useDynamicResolution;
+					std::cout << "\n\nDYNAMIC RESOLUTION : " << (useDynamicResolution ? "On" : "Off") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9) {
+					useRefinement = !useRefinement;
+					std::cout << "\n\nREFINEMENT : " << (useRefinement ? "On" : "Off") << std::endl;
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_P) {
 					// Print pixel currently hovered over for debug purposes
 					SDL_GetMouseState(&xMouse, &yMouse);
@@ -89,10 +133,30 @@ int main(int argc, char* args[])
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		//Runs while the render thread works on the previous frame. That frame is stale once the camera moves,
+		//a scene that only animates lets it finish refining.
+		if (pPipeline->GetBackScene()->GetCamera().HasInput())
+			pPipeline->CancelFrame();
+		const bool viewChanged = pPipeline->GetBackScene()->Update(pTimer);
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		pPipeline->WaitForFrame();
+		for (const SDL_Scancode key : rendererKeys)
+			applyRendererKey(key);
+		rendererKeys.clear();
+		if (viewChanged)
+			pRenderer->ResetAccumulation();
+		//Full resolution comes back once the camera stops, even while the scene keeps animating
+		const bool cameraMoved = pPipeline->GetBackScene()->HasCameraMoved();
+		pRenderer->SetRenderScale(useDynamicResolution ? dynamicResolution.Update(pTimer->GetElapsed(), cameraMoved) : 1.f);
+		pPipeline->StartFrame(useRefinement);
+
+		//--------- Present ---------
+		//The finished frame goes to the window while the next one renders
+		const std::vector<uint32_t>& frontBuffer = pPipeline->GetFrontBuffer();
+		SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_ARGB8888, frontBuffer.data(), width * sizeof(uint32_t),
+			pWindowSurface->format->format, pWindowSurface->pixels, pWindowSurface->pitch);
+		SDL_UpdateWindowSurface(pWindow);
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -103,10 +167,10 @@ int main(int argc, char* args[])
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
 		}
 
-		//Save screenshot after full render
+		//Save screenshot of the presented frame
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
+			if (!SDL_SaveBMP(pWindowSurface, "RayTracing_Buffer.bmp"))
 				std::cout << "Screenshot saved!" << std::endl;
 			else
 				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
@@ -116,7 +180,9 @@ int main(int argc, char* args[])
 	pTimer->Stop();
 
 	//Shutdown "framework"
+	delete pPipeline;
 	delete pScene;
+	delete pBackScene;
 	delete pRenderer;
 	delete pTimer;
 